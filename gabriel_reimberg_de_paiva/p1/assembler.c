@@ -5,44 +5,58 @@
 #include <string.h>
 #include <ctype.h>
 
-#define HEADERSIZE 4         
-#define MEMORYSIZE 512       
-#define LINESIZE 16          
-#define DATA_START 0x100     
-
-#define OPCODE_NOP  0x00
-#define OPCODE_STA  0x10
-#define OPCODE_LDA  0x20
-#define OPCODE_ADD  0x30
-#define OPCODE_SUB  0x31
-#define OPCODE_OR   0x40
-#define OPCODE_AND  0x50
-#define OPCODE_NOT  0x60
-#define OPCODE_JMP  0x80
-#define OPCODE_JMN  0x90
-#define OPCODE_JMZ  0xA0
-#define OPCODE_HLT  0xF0
-
-#define RESULTOFFSET (DATA_START + 4)
+#include "neander.h"
+#include "layout.h"
+#include "stats.h"
 
 typedef struct {
     char name[32];
     int address;
     int value;
     bool defined;
+    bool isData;
+    bool implicit;
+    bool external;
+    bool exported;
 } Symbol;
 
-#define MAX_SYMBOLS 256
+#define MAX_SYMBOLS 4096
 Symbol symbols[MAX_SYMBOLS];
 int symbolCount = 0;
 
-void addSymbol(const char* name, int address, int value, bool defined) {
+/* Objeto relocável (--object): código na palavra 0, dados logo após, RES importado */
+const Layout OBJECT_LAYOUT = { HEADER_OBJECT, HEADERSIZE, 2, EXTENDED_MAX_WORDS, -1, EXTENDED_MAX_WORDS - 1, -1 };
+
+typedef struct {
+    int word;
+    int symbol;     /* índice em symbols[] se externo, -1 se interno */
+} Relocation;
+
+#define MAX_RELOCATIONS 16384
+Relocation relocations[MAX_RELOCATIONS];
+int relocationCount = 0;
+
+void addRelocation(int word, int symbol) {
+    if (relocationCount < MAX_RELOCATIONS) {
+        relocations[relocationCount].word = word;
+        relocations[relocationCount].symbol = symbol;
+        relocationCount++;
+    } else {
+        fprintf(stderr, "Erro: tabela de relocações cheia\n");
+    }
+}
+
+void addSymbol(const char* name, int address, int value, bool defined, bool isData) {
     if (symbolCount < MAX_SYMBOLS) {
         strncpy(symbols[symbolCount].name, name, sizeof(symbols[symbolCount].name) - 1);
         symbols[symbolCount].name[sizeof(symbols[symbolCount].name) - 1] = '\0';
         symbols[symbolCount].address = address;
         symbols[symbolCount].value = value;
         symbols[symbolCount].defined = defined;
+        symbols[symbolCount].isData = isData;
+        symbols[symbolCount].implicit = false;
+        symbols[symbolCount].external = false;
+        symbols[symbolCount].exported = false;
         symbolCount++;
     } else {
         fprintf(stderr, "Erro: tabela de símbolos cheia\n");
@@ -57,6 +71,14 @@ int findSymbol(const char* name) {
     return -1;
 }
 
+int findSymbolIndex(const char* name) {
+    for (int i = 0; i < symbolCount; i++) {
+        if (strcmp(symbols[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
 bool symbolExists(const char* name) {
     for (int i = 0; i < symbolCount; i++) {
         if (strcmp(symbols[i].name, name) == 0)
@@ -65,6 +87,29 @@ bool symbolExists(const char* name) {
     return false;
 }
 
+
+
+/* Para um símbolo externo devolve só o deslocamento; *external recebe o índice dele ou -1 */
+int resolveOperand(const char* operand, int* external) {
+    char name[32];
+    int offset = 0;
+    *external = -1;
+    if (sscanf(operand, "%31[^+]+%d", name, &offset) < 1)
+        return -1;
+    int index = findSymbolIndex(name);
+    if (index < 0)
+        return -1;
+    if (symbols[index].external) {
+        *external = index;
+        return offset;
+    }
+    return symbols[index].address + offset;
+}
+
+bool isSymbolName(const char* str) {
+    return isalpha((unsigned char)str[0]) || str[0] == '_';
+}
+
 int parseNumber(const char* str) {
     if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
         return (int)strtol(str, NULL, 16);
@@ -72,6 +117,105 @@ int parseNumber(const char* str) {
         return atoi(str);
 }
 
+FILE* listFile = NULL;
+
+const char* instructionCycles(uint8_t opcode) {
+    switch (opcode) {
+        case OPCODE_NOP:
+        case OPCODE_NOT:
+        case OPCODE_HLT: return "4";
+        case OPCODE_JMP: return "6";
+        case OPCODE_JMN:
+        case OPCODE_JMZ: return "4/6";
+        default:         return "8";
+    }
+}
+
+/*
+ * Uma linha do .lst: número da linha, palavra, offset no arquivo, bytes
+ * codificados, ciclos e fonte. Como no .map, o PC do executor é o offset
+ * no formato padrão e a palavra nos demais.
+ */
+void listSource(int lineNumber, const Layout* layout, int word, const uint8_t* bytes, int count, const char* cycles,
+                const char* source) {
+    if (!listFile) return;
+    char encoded[16] = "";
+    for (int i = 0; i < count && i < 4; i++)
+        sprintf(encoded + i * 3, "%02X ", bytes[i]);
+    if (word >= 0)
+        fprintf(listFile, "%5d  %7d  0x%04X  %-12s %-4s  %s\n", lineNumber, word, wordOffset(layout, word), encoded,
+                cycles, source);
+    else
+        fprintf(listFile, "%5d  %7s  %-6s  %-12s %-4s  %s\n", lineNumber, "", "", encoded, cycles, source);
+}
+
+bool writeMap(const char* mapFile, const Layout* layout, int codeEnd) {
+    FILE* fmap = fopen(mapFile, "w");
+    if (!fmap) {
+        perror("Erro ao criar o arquivo de mapa");
+        return false;
+    }
+    fprintf(fmap, "# layout %s\n", layout == &OBJECT_LAYOUT ? "object" : layoutName(layout));
+    fprintf(fmap, "# simbolo palavra offset tamanho tipo origem\n");
+    for (int i = 0; i < symbolCount; i++) {
+        const Symbol* sym = &symbols[i];
+        int size = layout->bytesPerWord;
+        if (!sym->isData) {
+            /* um rótulo cobre o código até o próximo rótulo */
+            int end = codeEnd;
+            for (int j = 0; j < symbolCount; j++) {
+                if (!symbols[j].isData && symbols[j].address > sym->address && symbols[j].address < end)
+                    end = symbols[j].address;
+            }
+            size = (end - sym->address) * layout->bytesPerWord;
+        }
+        if (sym->external) {
+            fprintf(fmap, "%-24s %3s %6s %4d %-6s %s\n", sym->name, "-", "-", 0, "-", "externo");
+            continue;
+        }
+        fprintf(fmap, "%-24s %3d 0x%04X %4d %-6s %s\n", sym->name, sym->address,
+                wordOffset(layout, sym->address), size, sym->isData ? "dados" : "codigo",
+                sym->implicit ? "implicito" : "definido");
+    }
+    fclose(fmap);
+    return true;
+}
+
+void writeU16(FILE* out, int value) {
+    fputc(value & 0xFF, out);
+    fputc((value >> 8) & 0xFF, out);
+}
+
+void writeObject(FILE* out, const uint8_t* memory, int codeWords, int totalWords) {
+    const uint8_t header[] = HEADER_OBJECT;
+    fwrite(header, 1, HEADERSIZE, out);
+    writeU16(out, codeWords);
+    writeU16(out, totalWords);
+    for (int i = 0; i < totalWords; i++)
+        writeU16(out, memory[wordOffset(&OBJECT_LAYOUT, i)] | (memory[wordOffset(&OBJECT_LAYOUT, i) + 1] << 8));
+
+    /* só exportados e importados vão para o objeto; objectIndex traduz o índice das relocações */
+    static int objectIndex[MAX_SYMBOLS];
+    int exportedCount = 0;
+    for (int i = 0; i < symbolCount; i++) {
+        if (symbols[i].external || symbols[i].exported)
+            objectIndex[i] = exportedCount++;
+    }
+    writeU16(out, exportedCount);
+    for (int i = 0; i < symbolCount; i++) {
+        if (!symbols[i].external && !symbols[i].exported) continue;
+        fputc(symbols[i].external ? OBJECT_SYMBOL_IMPORT : OBJECT_SYMBOL_EXPORT, out);
+        fputc((int)strlen(symbols[i].name), out);
+        fputs(symbols[i].name, out);
+        writeU16(out, symbols[i].external ? 0 : symbols[i].address);
+    }
+    writeU16(out, relocationCount);
+    for (int i = 0; i < relocationCount; i++) {
+        writeU16(out, relocations[i].word);
+        writeU16(out, relocations[i].symbol < 0 ? OBJECT_INTERNAL : objectIndex[relocations[i].symbol]);
+    }
+}
+
 void cleanLine(char* line) {
     char* comment = strchr(line, ';');
     if (comment) *comment = '\0';
@@ -82,28 +226,35 @@ void cleanLine(char* line) {
     }
 }
 
-bool assemble(const char* inputFile, const char* outputFile) {
+bool assemble(const char* inputFile, const char* outputFile, const char* mapFile, const Layout* layout) {
     FILE *fin = fopen(inputFile, "r");
     if (!fin) {
         perror("Erro ao abrir o arquivo assembly");
         return false;
     }
     
-    uint8_t memory[MEMORYSIZE] = {0};
-    uint8_t header[HEADERSIZE] = {0x03, 0x4E, 0x44, 0x52};
-    memcpy(memory, header, HEADERSIZE);
+    bool relocatable = layout == &OBJECT_LAYOUT;
+    int imageSize = wordOffset(layout, layout->words);
+    uint8_t* memory = calloc(imageSize, 1);
+    writeHeader(memory, layout);
     
-    int dataAddr = DATA_START;
+    int dataAddr = 0;
     int codeOrigin = 0;
-    int codeStart = HEADERSIZE + codeOrigin * 2; 
-    int codeAddr = codeStart; 
+    int codeAddr = codeOrigin;
+    int codeEnd = 0;
     
     enum { NONE, DATA_SECTION, CODE_SECTION } section = NONE;
     
-    addSymbol("RES", RESULTOFFSET, 0, false);
+    addSymbol("RES", layout->resultWord, 0, false, true);
+    if (relocatable) {
+        symbols[0].external = true;
+        symbols[0].isData = false;
+    }
     
     char line[256];
-    int tempCodeAddr = codeStart;
+    int tempCodeAddr = codeOrigin;
+    StatStage stage;
+    stat_begin(&stage, "assemble.pass1");
     while (fgets(line, sizeof(line), fin)) {
         cleanLine(line);
         
@@ -112,12 +263,20 @@ bool assemble(const char* inputFile, const char* outputFile) {
         if (*p == '\0') continue;
         
         char label[32] = {0};
+        if (strncasecmp(p, ".EXTERN", 7) == 0) {
+            if (sscanf(p + 7, "%31s", label) == 1 && !symbolExists(label)) {
+                addSymbol(label, 0, 0, true, false);
+                symbols[symbolCount - 1].external = true;
+            }
+            continue;
+        }
+        if (strncasecmp(p, ".GLOBAL", 7) == 0) continue;
         if (strchr(p, ':')) {
             sscanf(p, "%31[^:]:", label);
             if (strlen(label) > 0 && section == CODE_SECTION) {
                 if (!symbolExists(label)) {
-                    addSymbol(label, tempCodeAddr, 0, true);
-                    printf("Rótulo encontrado: %s (endereço: %d)\n", label, tempCodeAddr);
+                    addSymbol(label, tempCodeAddr, 0, true, false);
+                    printf("Rótulo encontrado: %s (endereço: %d)\n", label, wordOffset(layout, tempCodeAddr));
                 }
                 continue;
             }
@@ -147,66 +306,129 @@ bool assemble(const char* inputFile, const char* outputFile) {
                     value = parseNumber(valueStr);
                 }
                 
-                if (dataAddr % 2 != 0) dataAddr++;
-                
                 if (!symbolExists(label)) {
-                    addSymbol(label, dataAddr, value, defined);
+                    addSymbol(label, dataAddr, value, defined, true);
                 }
-                
-                memory[dataAddr] = (uint8_t)value;
-                memory[dataAddr+1] = 0;
-                dataAddr += 2;
+                dataAddr++;
             }
         } else if (section == CODE_SECTION) {
             if (strncasecmp(p, ".ORG", 4) == 0) {
                 int org;
                 if (sscanf(p, ".ORG %d", &org) == 1) {
                     codeOrigin = org;
-                    codeStart = HEADERSIZE + codeOrigin * 2;
-                    tempCodeAddr = codeStart;;
+                    tempCodeAddr = codeOrigin;
                 }
                 continue;
             }
             
             char mnemonic[16], operand[32];
             if (sscanf(p, "%15s %31s", mnemonic, operand) >= 1) {
-                tempCodeAddr += 4;
+                tempCodeAddr += 2;
+                if (tempCodeAddr > codeEnd) codeEnd = tempCodeAddr;
             }
         }
     }
     rewind(fin);
+    stat_end(&stage);
+    
+    stat_begin(&stage, "assemble.pass2");
+    int dataBase = layout->dataStart >= 0 ? layout->dataStart : codeEnd;
+    /* no formato padrão os dados têm posição fixa; código além dela os sobreporia */
+    if (layout->dataStart >= 0 && codeEnd > layout->dataStart) {
+        fprintf(stderr, "Erro: código excede a memória (%d palavras, limite %d)\n", codeEnd, layout->dataStart);
+        fclose(fin);
+        free(memory);
+        return false;
+    }
+    /* symbols[0] é RES, que tem endereço fixo em cada layout */
+    for (int i = 1; i < symbolCount; i++) {
+        if (symbols[i].external && !relocatable) {
+            fprintf(stderr, "Erro: símbolo externo %s exige montagem com --object\n", symbols[i].name);
+            fclose(fin);
+            free(memory);
+            return false;
+        }
+        if (!symbols[i].isData) continue;
+        symbols[i].address += dataBase;
+        if (symbols[i].address >= layout->dataEnd) {
+            fprintf(stderr, "Erro: memória insuficiente para %s\n", symbols[i].name);
+            fclose(fin);
+            free(memory);
+            return false;
+        }
+        memory[wordOffset(layout, symbols[i].address)] = (uint8_t)symbols[i].value;
+    }
+    dataAddr += dataBase;
     
     section = NONE;
-    codeAddr = codeStart;
+    codeOrigin = 0;
+    codeAddr = codeOrigin;
+    int lineNumber = 0;
     while (fgets(line, sizeof(line), fin)) {
+        lineNumber++;
+        char source[256];
+        strcpy(source, line);
+        source[strcspn(source, "\r\n")] = '\0';
         cleanLine(line);
         
         char *p = line;
         while (isspace((unsigned char)*p)) p++;
-        if (*p == '\0') continue;
-        
-        if (strchr(p, ':')) {
+        if (*p == '\0' || strncasecmp(p, ".DATA", 5) == 0 || strncasecmp(p, ".CODE", 5) == 0) {
+            if (*p == '.') section = toupper((unsigned char)p[1]) == 'D' ? DATA_SECTION : CODE_SECTION;
+            listSource(lineNumber, layout, -1, NULL, 0, "", source);
             continue;
         }
         
-        if (strncasecmp(p, ".DATA", 5) == 0) {
-            section = DATA_SECTION;
+        if (strncasecmp(p, ".EXTERN", 7) == 0 || strncasecmp(p, ".GLOBAL", 7) == 0) {
+            char name[32];
+            if (toupper((unsigned char)p[1]) == 'G' && sscanf(p + 7, "%31s", name) == 1) {
+                int index = findSymbolIndex(name);
+                if (index < 0 || symbols[index].external) {
+                    fprintf(stderr, "Símbolo exportado indefinido: %s\n", name);
+                    fclose(fin);
+                    free(memory);
+                    return false;
+                }
+                symbols[index].exported = true;
+            }
+            listSource(lineNumber, layout, -1, NULL, 0, "", source);
             continue;
         }
-        if (strncasecmp(p, ".CODE", 5) == 0) {
-            section = CODE_SECTION;
+        
+        if (strchr(p, ':')) {
+            listSource(lineNumber, layout, codeAddr, NULL, 0, "", source);
             continue;
         }
         
         if (section == DATA_SECTION) {
+            char label[32], directive[16], valueStr[32];
+            int items = sscanf(p, "%31s %15s %31s", label, directive, valueStr);
+            if (items == 3 && isSymbolName(valueStr)) {
+                int external;
+                int target = resolveOperand(valueStr, &external);
+                if (target < 0) {
+                    fprintf(stderr, "Símbolo indefinido: %s\n", valueStr);
+                    listSource(lineNumber, layout, -1, NULL, 0, "", source);
+                    continue;
+                }
+                storeWord(memory, layout, findSymbol(label), target);
+                if (relocatable)
+                    addRelocation(findSymbol(label), external);
+            }
+            int address = items >= 1 ? findSymbol(label) : -1;
+            if (address >= 0)
+                listSource(lineNumber, layout, address, &memory[wordOffset(layout, address)],
+                           layout->bytesPerWord, "", source);
+            else
+                listSource(lineNumber, layout, -1, NULL, 0, "", source);
         } else if (section == CODE_SECTION) {
             if (strncasecmp(p, ".ORG", 4) == 0) {
                 int org;
                 if (sscanf(p, ".ORG %d", &org) == 1) {
                     codeOrigin = org;
-                    codeStart = HEADERSIZE + codeOrigin * 2;
-                    codeAddr = codeStart;
+                    codeAddr = codeOrigin;
                 }
+                listSource(lineNumber, layout, -1, NULL, 0, "", source);
                 continue;
             }
             
@@ -216,7 +438,7 @@ bool assemble(const char* inputFile, const char* outputFile) {
             if (items < 1) continue;
             
             uint8_t opcode = 0;
-            uint8_t operandByte = 0;
+            int operandWord = 0;
             
             if (strcasecmp(mnemonic, "LDA") == 0) {
                 opcode = OPCODE_LDA;
@@ -244,55 +466,120 @@ bool assemble(const char* inputFile, const char* outputFile) {
                 opcode = OPCODE_AND;
             } else {
                 fprintf(stderr, "Mnemônico desconhecido: %s\n", mnemonic);
+                listSource(lineNumber, layout, -1, NULL, 0, "", source);
                 continue;
             }
             
             if (opcode != OPCODE_HLT && opcode != OPCODE_NOP && opcode != OPCODE_NOT && items == 2) {
-                int symAddr = findSymbol(operand);
+                int external;
+                int symAddr = resolveOperand(operand, &external);
+                if (symAddr < 0 && strchr(operand, '+')) {
+                    fprintf(stderr, "Símbolo indefinido: %s\n", operand);
+                    listSource(lineNumber, layout, -1, NULL, 0, "", source);
+                    continue;
+                }
                 if (symAddr < 0) {
-                    if (dataAddr % 2 != 0) dataAddr++;
-                    addSymbol(operand, dataAddr, 0, false);
+                    if (dataAddr >= layout->dataEnd) {
+                        fprintf(stderr, "Erro: memória insuficiente para %s\n", operand);
+                        fclose(fin);
+                        free(memory);
+                        return false;
+                    }
+                    addSymbol(operand, dataAddr, 0, false, true);
+                    symbols[symbolCount - 1].implicit = true;
                     symAddr = dataAddr;
-                    dataAddr += 2;
+                    dataAddr++;
                 }
-                operandByte = (uint8_t)((symAddr - HEADERSIZE) / 2);
+                operandWord = symAddr;
+                if (relocatable)
+                    addRelocation(codeAddr + 1, external);
             }
             
-            memory[codeAddr]   = opcode;
-            memory[codeAddr+1] = 0;
-            memory[codeAddr+2] = operandByte;
-            memory[codeAddr+3] = 0;
+            if (codeAddr + 1 >= layout->words) {
+                fprintf(stderr, "Erro: código excede a memória\n");
+                fclose(fin);
+                free(memory);
+                return false;
+            }
+            memory[wordOffset(layout, codeAddr)] = opcode;
+            storeWord(memory, layout, codeAddr + 1, operandWord);
+            listSource(lineNumber, layout, codeAddr, &memory[wordOffset(layout, codeAddr)],
+                       2 * layout->bytesPerWord, instructionCycles(opcode), source);
             
-            codeAddr += 4;
+            codeAddr += 2;
         }
     }
     fclose(fin);
+    stat_end(&stage);
 
     FILE *fout = fopen(outputFile, "wb");
     if (!fout) {
         perror("Erro ao criar o arquivo de memória");
+        free(memory);
         return false;
     }
-    fwrite(memory, 1, MEMORYSIZE, fout);
+    if (relocatable)
+        writeObject(fout, memory, codeEnd, dataAddr);
+    else
+        fwrite(memory, 1, imageSize, fout);
     fclose(fout);
+    free(memory);
+    if (mapFile && !writeMap(mapFile, layout, codeEnd)) return false;
     return true;
 }
 
 int main(int argc, char *argv[]) {
     char inputFile[256] = "programa.asm";
     char outputFile[256] = "programa.mem";
+    const Layout* layout = &STANDARD_LAYOUT;
+    Layout extended = EXTENDED_LAYOUT;
+    const char* listPath = NULL;
+    const char* mapPath = NULL;
     
-    if (argc > 1) {
-        strncpy(inputFile, argv[1], sizeof(inputFile) - 1);
-        inputFile[sizeof(inputFile) - 1] = '\0';
-    }
-    if (argc > 2) {
-        strncpy(outputFile, argv[2], sizeof(outputFile) - 1);
-        outputFile[sizeof(outputFile) - 1] = '\0';
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--packed") == 0) {
+            layout = &PACKED_LAYOUT;
+        } else if (strcmp(argv[i], "--object") == 0) {
+            layout = &OBJECT_LAYOUT;
+        } else if (strcmp(argv[i], "--extended") == 0) {
+            layout = &extended;
+        } else if (strcmp(argv[i], "--words") == 0 && i + 1 < argc) {
+            int words = atoi(argv[++i]);
+            if (words < 4 || words > EXTENDED_MAX_WORDS) {
+                printf("Tamanho de memória inválido: %s (4 a %d palavras)\n", argv[i], EXTENDED_MAX_WORDS);
+                return 1;
+            }
+            setExtendedWords(&extended, words);
+        } else if (strcmp(argv[i], "--lst") == 0 && i + 1 < argc) {
+            listPath = argv[++i];
+        } else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            mapPath = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsEnabled = true;
+        } else if (positional == 0) {
+            strncpy(inputFile, argv[i], sizeof(inputFile) - 1);
+            inputFile[sizeof(inputFile) - 1] = '\0';
+            positional++;
+        } else if (positional == 1) {
+            strncpy(outputFile, argv[i], sizeof(outputFile) - 1);
+            outputFile[sizeof(outputFile) - 1] = '\0';
+            positional++;
+        }
     }
     
     printf("%s -> %s\n", inputFile, outputFile);
-    if (!assemble(inputFile, outputFile)) {return 1;}
+    if (listPath) {
+        listFile = fopen(listPath, "w");
+        if (!listFile) {
+            perror("Erro ao criar o arquivo de listagem");
+            return 1;
+        }
+        fprintf(listFile, "%5s  %7s  %-6s  %-12s %-4s  %s\n", "Linha", "Palavra", "Ender", "Bytes", "Cicl", "Fonte");
+    }
+    bool ok = assemble(inputFile, outputFile, mapPath, layout);
+    if (listFile) fclose(listFile);
+    if (!ok) {return 1;}
     
     return 0;
 }
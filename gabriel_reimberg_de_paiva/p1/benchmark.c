@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MAX_SAMPLES 1000
+#define MAX_STAGES 16
+#define BENCH_DIR "bench"
+
+typedef struct {
+    char name[32];
+    uint64_t samples[MAX_SAMPLES];
+    int count;
+} StageSamples;
+
+typedef struct {
+    const char *name;
+    void (*generate)(FILE *out, int size);
+    int size;
+} BenchCase;
+
+StageSamples stages[MAX_STAGES];
+int stageCount = 0;
+
+void genStatements(FILE *out, int size) {
+    fprintf(out, "v0 = 1\n");
+    for (int i = 1; i < size; i++)
+        fprintf(out, "v%d = v%d + %d\n", i, i - 1, i % 7 + 1);
+    fprintf(out, "RES = v%d\n", size - 1);
+}
+
+void genDeepExpression(FILE *out, int size) {
+    fprintf(out, "a = 5\n");
+    fprintf(out, "RES = ");
+    for (int i = 0; i < size; i++)
+        fprintf(out, "a %c (", i % 2 ? '-' : '+');
+    fprintf(out, "a");
+    for (int i = 0; i < size; i++)
+        fprintf(out, ")");
+    fprintf(out, "\n");
+}
+
+void genMultiplier(FILE *out, int size) {
+    fprintf(out, "a = 3\n");
+    fprintf(out, "RES = a * %d\n", size);
+}
+
+void genDivision(FILE *out, int size) {
+    fprintf(out, "a = %d\n", size);
+    fprintf(out, "b = 1\n");
+    fprintf(out, "RES = a / b + a %% 3\n");
+}
+
+void genPower(FILE *out, int size) {
+    fprintf(out, "a = 3\n");
+    fprintf(out, "b = %d\n", size);
+    fprintf(out, "RES = a ^ b\n");
+}
+
+const BenchCase CASES[] = {
+    { "instrucoes",    genStatements,     8   },
+    { "instrucoes",    genStatements,     16  },
+    { "instrucoes",    genStatements,     128 },
+    { "expressao",     genDeepExpression, 4   },
+    { "expressao",     genDeepExpression, 12  },
+    { "expressao",     genDeepExpression, 100 },
+    { "multiplicador", genMultiplier,     8   },
+    { "multiplicador", genMultiplier,     16  },
+    { "multiplicador", genMultiplier,     200 },
+    { "divisao",       genDivision,       127 },
+    { "potencia",      genPower,          7   },
+};
+
+StageSamples *findStage(const char *name) {
+    for (int i = 0; i < stageCount; i++) {
+        if (strcmp(stages[i].name, name) == 0)
+            return &stages[i];
+    }
+    if (stageCount == MAX_STAGES) return NULL;
+    StageSamples *stage = &stages[stageCount++];
+    strncpy(stage->name, name, sizeof(stage->name) - 1);
+    stage->name[sizeof(stage->name) - 1] = '\0';
+    stage->count = 0;
+    return stage;
+}
+
+/* Executa a ferramenta com --stats e coleta as linhas "stat <etapa> ns=<n>" de stderr. */
+int runTool(char *const argv[]) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    FILE *err = fdopen(fds[0], "r");
+    char line[256];
+    while (fgets(line, sizeof(line), err)) {
+        char name[32];
+        unsigned long long ns;
+        if (sscanf(line, "stat %31s ns=%llu", name, &ns) != 2) continue;
+        StageSamples *stage = findStage(name);
+        if (stage && stage->count < MAX_SAMPLES)
+            stage->samples[stage->count++] = ns;
+    }
+    fclose(err);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int compareSamples(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+uint64_t percentile(const StageSamples *stage, int pct) {
+    int rank = (stage->count * pct + 99) / 100;
+    if (rank < 1) rank = 1;
+    return stage->samples[rank - 1];
+}
+
+void currentCommit(char *buffer, size_t size) {
+    strncpy(buffer, "desconhecido", size);
+    FILE *git = popen("git rev-parse --short HEAD 2>/dev/null", "r");
+    if (!git) return;
+    if (fgets(buffer, size, git))
+        buffer[strcspn(buffer, "\n")] = '\0';
+    pclose(git);
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 30;
+    bool packed = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--packed") == 0) {
+            packed = true;
+        } else {
+            printf("Uso: %s [--runs N] [--packed]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1 || runs > MAX_SAMPLES) {
+        printf("Número de execuções deve estar entre 1 e %d\n", MAX_SAMPLES);
+        return 1;
+    }
+
+    mkdir(BENCH_DIR, 0755);
+    char commit[64];
+    currentCommit(commit, sizeof(commit));
+
+    FILE *csv = fopen(BENCH_DIR "/resultados.csv", "w");
+    FILE *json = fopen(BENCH_DIR "/resultados.json", "w");
+    if (!csv || !json) {
+        perror("Erro ao criar arquivos de resultado");
+        return 1;
+    }
+    fprintf(csv, "commit,caso,tamanho,etapa,n,min_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+    fprintf(json, "{\"commit\":\"%s\",\"runs\":%d,\"layout\":\"%s\",\"resultados\":[", commit, runs, packed ? "packed" : "standard");
+
+    printf("%-14s %5s %-18s %10s %10s %10s %10s\n", "caso", "tam", "etapa", "min", "p50", "p90", "p99");
+    bool firstJson = true;
+    int caseCount = sizeof(CASES) / sizeof(CASES[0]);
+    for (int c = 0; c < caseCount; c++) {
+        const BenchCase *bc = &CASES[c];
+        char lpnFile[128], asmFile[128], memFile[128];
+        snprintf(lpnFile, sizeof(lpnFile), BENCH_DIR "/%s_%d.lpn", bc->name, bc->size);
+        snprintf(asmFile, sizeof(asmFile), BENCH_DIR "/%s_%d.asm", bc->name, bc->size);
+        snprintf(memFile, sizeof(memFile), BENCH_DIR "/%s_%d.mem", bc->name, bc->size);
+
+        FILE *out = fopen(lpnFile, "w");
+        if (!out) {
+            perror(lpnFile);
+            return 1;
+        }
+        fprintf(out, "PROGRAMA \"%s%d\":\nINICIO\n", bc->name, bc->size);
+        bc->generate(out, bc->size);
+        fprintf(out, "FIM\n");
+        fclose(out);
+
+        stageCount = 0;
+        char *compile[] = { "./compilador", "--stats", lpnFile, NULL };
+        char *assemble[] = { "./assembler", "--stats", asmFile, memFile, packed ? "--packed" : NULL, NULL };
+        char *execute[] = { "./executor", "--stats", "--output", "regs", memFile, NULL };
+
+        bool assembled = true;
+        for (int r = 0; r < runs; r++) {
+            if (runTool(compile) != 0) {
+                assembled = false;
+                break;
+            }
+            if (assembled && runTool(assemble) != 0)
+                assembled = false;
+            if (assembled)
+                runTool(execute);
+        }
+        if (!assembled)
+            printf("%-14s %5d (não cabe na memória: apenas compilação medida)\n", bc->name, bc->size);
+
+        for (int s = 0; s < stageCount; s++) {
+            StageSamples *stage = &stages[s];
+            qsort(stage->samples, stage->count, sizeof(uint64_t), compareSamples);
+            uint64_t p50 = percentile(stage, 50), p90 = percentile(stage, 90), p99 = percentile(stage, 99);
+            printf("%-14s %5d %-18s %10llu %10llu %10llu %10llu\n", bc->name, bc->size, stage->name,
+                   (unsigned long long)stage->samples[0], (unsigned long long)p50,
+                   (unsigned long long)p90, (unsigned long long)p99);
+            fprintf(csv, "%s,%s,%d,%s,%d,%llu,%llu,%llu,%llu,%llu\n", commit, bc->name, bc->size, stage->name,
+                    stage->count, (unsigned long long)stage->samples[0], (unsigned long long)p50,
+                    (unsigned long long)p90, (unsigned long long)p99,
+                    (unsigned long long)stage->samples[stage->count - 1]);
+            fprintf(json, "%s{\"caso\":\"%s\",\"tamanho\":%d,\"etapa\":\"%s\",\"n\":%d,\"min_ns\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}",
+                    firstJson ? "" : ",", bc->name, bc->size, stage->name, stage->count,
+                    (unsigned long long)stage->samples[0], (unsigned long long)p50,
+                    (unsigned long long)p90, (unsigned long long)p99,
+                    (unsigned long long)stage->samples[stage->count - 1]);
+            firstJson = false;
+        }
+    }
+
+    fprintf(json, "]}\n");
+    fclose(csv);
+    fclose(json);
+    printf("Resultados em %s/resultados.csv e %s/resultados.json (tempos em ns)\n", BENCH_DIR, BENCH_DIR);
+    return 0;
+}
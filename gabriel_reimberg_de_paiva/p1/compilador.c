@@ -3,6 +3,14 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "neander.h"
+#include "stats.h"
 
 typedef enum { AST_NUM, AST_VAR, AST_BINOP } ASTNodeType;
 
@@ -21,20 +29,30 @@ typedef struct ASTNode {
 
 typedef struct Statement {
     char var[64];
+    int line;
     ASTNode* expr;
     struct Statement* next;
 } Statement;
 
-Statement* statements = NULL;
-Statement* lastStmt = NULL;
+_Thread_local Statement* statements = NULL;
+_Thread_local Statement* lastStmt = NULL;
 
 typedef struct {
     char name[64];
     Statement* stmts;
     ASTNode* resultExpr;
+    int resultLine;
 } Program;
 
-Program program;
+_Thread_local Program program;
+
+/* Em modo lote um erro de sintaxe aborta só o arquivo atual */
+_Thread_local jmp_buf* compileAbort = NULL;
+
+void failCompilation() {
+    if (compileAbort) longjmp(*compileAbort, 1);
+    exit(1);
+}
 
 typedef enum {
     TOKEN_PROGRAMA,
@@ -47,6 +65,9 @@ typedef enum {
     TOKEN_PLUS,
     TOKEN_MINUS,
     TOKEN_TIMES,
+    TOKEN_DIV,
+    TOKEN_MOD,
+    TOKEN_POW,
     TOKEN_LPAREN,
     TOKEN_RPAREN,
     TOKEN_COLON,
@@ -57,18 +78,21 @@ typedef enum {
 typedef struct {
     TokenType type;
     char lexeme[64];
+    int line;
 } Token;
 
-#define MAX_TOKENS 1024
-Token tokens[MAX_TOKENS];
-int tokenCount = 0;
-int currentToken = 0;
+#define MAX_TOKENS 32768
+_Thread_local Token tokens[MAX_TOKENS];
+_Thread_local int tokenCount = 0;
+_Thread_local int currentToken = 0;
 
-char* source;
-int sourcePos = 0;
+_Thread_local char* source;
+_Thread_local int sourcePos = 0;
+_Thread_local int sourceLine = 1;
 
 ASTNode* parseExpression();
 ASTNode* parseTerm();
+ASTNode* parsePower();
 ASTNode* parseFactor();
 
 typedef struct {
@@ -77,10 +101,10 @@ typedef struct {
     bool defined;
 } Var;
 
-#define MAX_VARS 256
-Var varTable[MAX_VARS];
-int varCount = 0;
-FILE* asmOut;
+#define MAX_VARS 4096
+_Thread_local Var varTable[MAX_VARS];
+_Thread_local int varCount = 0;
+_Thread_local FILE* asmOut;
 
 void skipWhitespace() {
     while (source[sourcePos] == ' ' || source[sourcePos] == '\t')
@@ -100,6 +124,7 @@ void addToken(TokenType type, const char *lexeme) {
         tokens[tokenCount].type = type;
         strncpy(tokens[tokenCount].lexeme, lexeme, sizeof(tokens[tokenCount].lexeme)-1);
         tokens[tokenCount].lexeme[sizeof(tokens[tokenCount].lexeme)-1] = '\0';
+        tokens[tokenCount].line = sourceLine;
         tokenCount++;
     }
 }
@@ -108,12 +133,14 @@ void tokenize() {
     tokenCount = 0;
     currentToken = 0;
     sourcePos = 0;
+    sourceLine = 1;
     while (source[sourcePos] != '\0') {
         if (source[sourcePos] == ' ' || source[sourcePos] == '\t') {
             skipWhitespace();
             continue;
         }
         if (source[sourcePos] == '\n' || source[sourcePos] == '\r') {
+            if (source[sourcePos] == '\n') sourceLine++;
             sourcePos++;
             continue;
         }
@@ -157,6 +184,21 @@ void tokenize() {
             sourcePos++;
             continue;
         }
+        if (source[sourcePos] == '/') {
+            addToken(TOKEN_DIV, "/");
+            sourcePos++;
+            continue;
+        }
+        if (source[sourcePos] == '%') {
+            addToken(TOKEN_MOD, "%");
+            sourcePos++;
+            continue;
+        }
+        if (source[sourcePos] == '^') {
+            addToken(TOKEN_POW, "^");
+            sourcePos++;
+            continue;
+        }
         if (source[sourcePos] == '(') {
             addToken(TOKEN_LPAREN, "(");
             sourcePos++;
@@ -249,23 +291,44 @@ ASTNode* newBinOpNode(char op, ASTNode* left, ASTNode* right) {
     return node;
 }
 
+/* Subárvores já montadas à espera do operando direito; liberadas se a compilação abortar */
+_Thread_local ASTNode* pendingNodes[MAX_TOKENS];
+_Thread_local int pendingCount = 0;
+
 ASTNode* parseExpression() {
     ASTNode* node = parseTerm();
     Token* t;
     while ((t = peekToken()) && (t->type == TOKEN_PLUS || t->type == TOKEN_MINUS)) {
         t = getToken();
+        pendingNodes[pendingCount++] = node;
         ASTNode* right = parseTerm();
+        pendingCount--;
         node = newBinOpNode(t->lexeme[0], node, right);
     }
     return node;
 }
 
 ASTNode* parseTerm() {
-    ASTNode* node = parseFactor();
+    ASTNode* node = parsePower();
     Token* t;
-    while ((t = peekToken()) && (t->type == TOKEN_TIMES)) {
+    while ((t = peekToken()) && (t->type == TOKEN_TIMES || t->type == TOKEN_DIV || t->type == TOKEN_MOD)) {
         t = getToken();
-        ASTNode* right = parseFactor();
+        pendingNodes[pendingCount++] = node;
+        ASTNode* right = parsePower();
+        pendingCount--;
+        node = newBinOpNode(t->lexeme[0], node, right);
+    }
+    return node;
+}
+
+ASTNode* parsePower() {
+    ASTNode* node = parseFactor();
+    Token* t = peekToken();
+    if (t && t->type == TOKEN_POW) {
+        t = getToken();
+        pendingNodes[pendingCount++] = node;
+        ASTNode* right = parsePower();
+        pendingCount--;
         node = newBinOpNode(t->lexeme[0], node, right);
     }
     return node;
@@ -288,6 +351,8 @@ ASTNode* parseFactor() {
         t = getToken();
         return newVarNode(t->lexeme);
     }
+    printf("Erro: expressão inválida na linha %d\n", t->line);
+    failCompilation();
     return NULL;
 }
 
@@ -308,6 +373,7 @@ void parseAssignment() {
     
     Statement* stmt = malloc(sizeof(Statement));
     strncpy(stmt->var, varName, sizeof(stmt->var));
+    stmt->line = t->line;
     stmt->expr = expr;
     stmt->next = NULL;
     if (statements == NULL) {
@@ -341,26 +407,26 @@ void parseProgram() {
     Token* t = getToken();
     if (!t || t->type != TOKEN_PROGRAMA) { 
         printf("Erro: esperado PROGRAMA\n"); 
-        exit(1); 
+        failCompilation(); 
     }
     
     t = getToken();
     if (!t || t->type != TOKEN_IDENT) { 
         printf("Erro: esperado nome do programa\n"); 
-        exit(1); 
+        failCompilation(); 
     }
     strncpy(program.name, t->lexeme, sizeof(program.name));
     
     t = getToken();
     if (!t || t->type != TOKEN_COLON) { 
         printf("Erro: esperado ':' após nome\n"); 
-        exit(1); 
+        failCompilation(); 
     }
     
     t = getToken();
     if (!t || t->type != TOKEN_INICIO) { 
         printf("Erro: esperado INICIO\n"); 
-        exit(1); 
+        failCompilation(); 
     }
     
     while (1) {
@@ -374,27 +440,61 @@ void parseProgram() {
     t = getToken();
     if (!t || t->type != TOKEN_RES) { 
         printf("Erro: esperado RES\n"); 
-        exit(1); 
-    }    
+        failCompilation(); 
+    }
+    program.resultLine = t->line;
     t = getToken();
     if (!t || t->type != TOKEN_EQ) { 
         printf("Erro: esperado '=' após RES\n"); 
-        exit(1); 
+        failCompilation(); 
     }
     program.resultExpr = parseExpression();
     
     t = getToken();
     if (!t || t->type != TOKEN_FIM) { 
         printf("Erro: esperado FIM\n"); 
-        exit(1); 
+        failCompilation(); 
     }
 }
 
+/*
+ * Cache incremental (--cache): enquanto uma instrução é gerada, cada efeito
+ * colateral da geração vira uma linha do fragmento, para que um acerto no
+ * cache reproduza exatamente o mesmo estado (tabela de variáveis, temporários,
+ * chamadas de rotina e relatório de custo):
+ *   I <mnemônico> <operando|->   instrução; @k é o k-ésimo TEMP da instrução
+ *   V <nome>                     addVar
+ *   U <nome> <valor>             updateVarValue
+ *   K <valor>                    ensureConstantExists
+ *   T                            newTemp
+ *   C <rotina>                   genRoutineCall
+ *   E                            fim do fragmento
+ */
+#define CACHE_VERSION "lpn-cache-2"
+
+const char* cacheDir = NULL;
+_Thread_local FILE* fragmentOut = NULL;
+_Thread_local int fragmentSuppress = 0;
+_Thread_local int fragmentTempBase = 0;
+_Thread_local int workerId = 0;
+_Thread_local int cacheHits = 0;
+_Thread_local int cacheMisses = 0;
+
+bool recordingFragment() {
+    return fragmentOut && fragmentSuppress == 0;
+}
+
 int addVar(const char* name) {
+    if (recordingFragment())
+        fprintf(fragmentOut, "V %s\n", name);
     for (int i = 0; i < varCount; i++) {
         if (strcmp(varTable[i].name, name) == 0)
             return i;
     }
+    if (varCount >= MAX_VARS) {
+        printf("Erro: limite de %d variáveis excedido\n", MAX_VARS);
+        failCompilation();
+    }
     strncpy(varTable[varCount].name, name, sizeof(varTable[varCount].name)-1);
     varTable[varCount].name[sizeof(varTable[varCount].name)-1] = '\0';
     varTable[varCount].value = 0;
@@ -404,34 +504,493 @@ int addVar(const char* name) {
 }
 
 void updateVarValue(const char* name, int value) {
-    for (int i = 0; i < varCount; i++) {
-        if (strcmp(varTable[i].name, name) == 0) {
-            varTable[i].value = value;
-            varTable[i].defined = true;
-            return;
-        }
-    }
-    addVar(name);
-    updateVarValue(name, value);
+    if (recordingFragment())
+        fprintf(fragmentOut, "U %s %d\n", name, value);
+    fragmentSuppress++;
+    int i = addVar(name);
+    varTable[i].value = value;
+    varTable[i].defined = true;
+    fragmentSuppress--;
 }
 
 void ensureConstantExists(int value) {
     char constName[64];
     sprintf(constName, "CONST_%d", value);
+    /* gravado mesmo se a constante já existe: o fragmento pode ser reusado num programa sem ela */
+    if (recordingFragment())
+        fprintf(fragmentOut, "K %d\n", value);
     for (int i = 0; i < varCount; i++) {
         if (strcmp(varTable[i].name, constName) == 0)
             return;
     }
+    fragmentSuppress++;
     addVar(constName);
     updateVarValue(constName, value);
+    fragmentSuppress--;
+}
+
+#define MAX_COST_DATA 64
+#define MAX_PROGRAM_DATA 4096
+
+typedef struct {
+    int instructions;
+    int cycles;
+    int divCalls;
+    int powCalls;
+    int mulCalls;
+    int dataCount;
+    char data[MAX_COST_DATA][64];
+} Cost;
+
+typedef struct {
+    int line;
+    char text[128];
+    Cost cost;
+} StatementReport;
+
+_Thread_local StatementReport* reports = NULL;
+_Thread_local int reportCount = 0;
+_Thread_local Cost* currentCost = NULL;
+_Thread_local Cost divRoutineCost, powRoutineCost, mulRoutineCost;
+_Thread_local int divWorstCycles = 0, powWorstCycles = 0, mulWorstCycles = 0;
+_Thread_local int programInstructions = 0;
+_Thread_local int programDataCount = 0;
+_Thread_local char programData[MAX_PROGRAM_DATA][64];
+
+int mnemonicCycles(const char* mnemonic) {
+    if (strcmp(mnemonic, "NOP") == 0) return CYCLES_NOP;
+    if (strcmp(mnemonic, "NOT") == 0) return CYCLES_NOT;
+    if (strcmp(mnemonic, "HLT") == 0) return CYCLES_HLT;
+    if (mnemonic[0] == 'J') return CYCLES_JUMP;
+    return CYCLES_MEMORY;
+}
+
+bool addDataName(char names[][64], int* count, int max, const char* name) {
+    for (int i = 0; i < *count; i++) {
+        if (strcmp(names[i], name) == 0)
+            return false;
+    }
+    if (*count >= max) return false;
+    strncpy(names[*count], name, 63);
+    names[*count][63] = '\0';
+    (*count)++;
+    return true;
 }
 
-int tempCount = 0;
-char tempBuffer[64];
+void emit(const char* mnemonic, const char* operand) {
+    if (recordingFragment()) {
+        int temp;
+        if (!operand)
+            fprintf(fragmentOut, "I %s -\n", mnemonic);
+        else if (sscanf(operand, "TEMP_%d", &temp) == 1 && temp >= fragmentTempBase)
+            fprintf(fragmentOut, "I %s @%d\n", mnemonic, temp - fragmentTempBase);
+        else
+            fprintf(fragmentOut, "I %s %s\n", mnemonic, operand);
+    }
+    if (operand)
+        fprintf(asmOut, "%s %s\n", mnemonic, operand);
+    else
+        fprintf(asmOut, "%s\n", mnemonic);
+
+    programInstructions++;
+    bool isData = operand && mnemonic[0] != 'J' && !strchr(operand, '+');
+    if (isData)
+        addDataName(programData, &programDataCount, MAX_PROGRAM_DATA, operand);
+    if (!currentCost) return;
+    currentCost->instructions++;
+    currentCost->cycles += mnemonicCycles(mnemonic);
+    if (isData)
+        addDataName(currentCost->data, &currentCost->dataCount, MAX_COST_DATA, operand);
+}
+
+void emitLabel(const char* label) {
+    fprintf(asmOut, "%s:\n", label);
+}
+
+void emitData(const char* name, const char* value) {
+    fprintf(asmOut, "%s DB %s\n", name, value);
+    addDataName(programData, &programDataCount, MAX_PROGRAM_DATA, name);
+}
+
+void emitDataValue(const char* name, int value) {
+    char buffer[16];
+    sprintf(buffer, "%d", value);
+    emitData(name, buffer);
+}
+
+_Thread_local int tempCount = 0;
+_Thread_local char tempBuffer[64];
 
 void newTemp(char* buffer) {
+    if (recordingFragment())
+        fprintf(fragmentOut, "T\n");
+    fragmentSuppress++;
     sprintf(buffer, "TEMP_%d", tempCount++);
     addVar(buffer);
+    fragmentSuppress--;
+}
+
+_Thread_local bool usesDivRoutine = false;
+_Thread_local bool usesPowRoutine = false;
+_Thread_local int callCount = 0;
+
+void genExpr(ASTNode* node);
+
+/* Mesmas regras das rotinas: operandos de 8 bits sem sinal, divisão por zero dá quociente 0 e resto x */
+int foldConstant(char op, int left, int right) {
+    left &= 0xFF;
+    right &= 0xFF;
+    if (op == '/') return right ? left / right : 0;
+    if (op == '%') return right ? left % right : left;
+    int result = 1;
+    for (int i = 0; i < right; i++)
+        result = (result * left) & 0xFF;
+    return result;
+}
+
+void genRoutineCall(const char* routine) {
+    if (recordingFragment())
+        fprintf(fragmentOut, "C %s\n", routine);
+    fragmentSuppress++;
+    char operand[64];
+    sprintf(operand, "RT_RETADDR_%d", callCount);
+    emit("LDA", operand);
+    sprintf(operand, "%s_RET+1", routine);
+    emit("STA", operand);
+    emit("JMP", routine);
+    sprintf(operand, "RT_RET_%d", callCount);
+    emitLabel(operand);
+    callCount++;
+
+    if (currentCost) {
+        if (strcmp(routine, "RT_DIV") == 0) currentCost->divCalls++;
+        else if (strcmp(routine, "RT_POW") == 0) currentCost->powCalls++;
+        else currentCost->mulCalls++;
+    }
+    fragmentSuppress--;
+}
+
+void genRuntimeOp(ASTNode* node) {
+    char op = node->binop.op;
+    ASTNode* left = node->binop.left;
+    ASTNode* right = node->binop.right;
+
+    if (left->type == AST_NUM && right->type == AST_NUM) {
+        int result = foldConstant(op, left->num, right->num);
+        char constName[64];
+        sprintf(constName, "CONST_%d", result);
+        ensureConstantExists(result);
+        emit("LDA", constName);
+        return;
+    }
+
+    char leftName[64];
+    if (left->type == AST_VAR) {
+        addVar(left->var);
+        strcpy(leftName, left->var);
+    } else if (left->type == AST_NUM) {
+        sprintf(leftName, "CONST_%d", left->num);
+        ensureConstantExists(left->num);
+    } else {
+        genExpr(left);
+        newTemp(leftName);
+        emit("STA", leftName);
+    }
+    genExpr(right);
+    emit("STA", "RT_Y");
+    emit("LDA", leftName);
+    emit("STA", "RT_X");
+
+    if (op == '^') {
+        usesPowRoutine = true;
+        genRoutineCall("RT_POW");
+        emit("LDA", "RT_P");
+    } else {
+        usesDivRoutine = true;
+        genRoutineCall("RT_DIV");
+        emit("LDA", op == '/' ? "RT_Q" : "RT_X");
+    }
+}
+
+/* Passagens pelo laço de cada rotina no pior caso (operandos de 8 bits) */
+#define DIV_ITERATIONS 256
+#define MUL_ITERATIONS 8
+#define POW_ITERATIONS 8
+
+int precedence(char op) {
+    if (op == '+' || op == '-') return 1;
+    if (op == '^') return 3;
+    return 2;
+}
+
+void exprToString(ASTNode* node, char* buffer, size_t size) {
+    if (!node) {
+        snprintf(buffer, size, "?");
+    } else if (node->type == AST_NUM) {
+        snprintf(buffer, size, "%d", node->num);
+    } else if (node->type == AST_VAR) {
+        snprintf(buffer, size, "%s", node->var);
+    } else {
+        char left[112], right[112];
+        char op = node->binop.op;
+        exprToString(node->binop.left, left, sizeof(left));
+        exprToString(node->binop.right, right, sizeof(right));
+        ASTNode* l = node->binop.left;
+        ASTNode* r = node->binop.right;
+        bool leftParens = l && l->type == AST_BINOP &&
+            (precedence(l->binop.op) < precedence(op) || (op == '^' && l->binop.op == '^'));
+        bool rightParens = r && r->type == AST_BINOP &&
+            (precedence(r->binop.op) < precedence(op) || (precedence(r->binop.op) == precedence(op) && op != '^'));
+        snprintf(buffer, size, "%s%s%s %c %s%s%s",
+                 leftParens ? "(" : "", left, leftParens ? ")" : "", op,
+                 rightParens ? "(" : "", right, rightParens ? ")" : "");
+    }
+}
+
+Cost* newReport(int line, const char* var, ASTNode* expr) {
+    reports = realloc(reports, (reportCount + 1) * sizeof(StatementReport));
+    StatementReport* report = &reports[reportCount++];
+    memset(report, 0, sizeof(StatementReport));
+    report->line = line;
+    char text[112];
+    exprToString(expr, text, sizeof(text));
+    snprintf(report->text, sizeof(report->text), "%s = %s", var, text);
+    return &report->cost;
+}
+
+int estimatedCycles(const Cost* cost) {
+    return cost->cycles + cost->divCalls * divWorstCycles + cost->powCalls * powWorstCycles
+         + cost->mulCalls * mulWorstCycles;
+}
+
+typedef struct {
+    int instructions;
+    int data;
+    int cycles;
+    int stmtInstructions;
+    int stmtCycles;
+} Budget;
+
+bool parseBudget(const char* spec, Budget* budget) {
+    char buffer[256];
+    strncpy(buffer, spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    for (char* item = strtok(buffer, ","); item; item = strtok(NULL, ",")) {
+        char key[32];
+        int value;
+        if (sscanf(item, "%31[^=]=%d", key, &value) != 2) return false;
+        if (strcmp(key, "instr") == 0) budget->instructions = value;
+        else if (strcmp(key, "data") == 0) budget->data = value;
+        else if (strcmp(key, "cycles") == 0) budget->cycles = value;
+        else if (strcmp(key, "stmt-instr") == 0) budget->stmtInstructions = value;
+        else if (strcmp(key, "stmt-cycles") == 0) budget->stmtCycles = value;
+        else return false;
+    }
+    return true;
+}
+
+void printReport() {
+    printf("%5s %6s %6s %8s  %s\n", "Linha", "Instr", "Dados", "Ciclos", "Instrução");
+    for (int i = 0; i < reportCount; i++) {
+        printf("%5d %6d %6d %8d  %s\n", reports[i].line, reports[i].cost.instructions,
+               reports[i].cost.dataCount, estimatedCycles(&reports[i].cost), reports[i].text);
+    }
+    if (usesDivRoutine)
+        printf("%5s %6d %6d %8d  RT_DIV (pior caso por chamada)\n", "-", divRoutineCost.instructions,
+               divRoutineCost.dataCount, divWorstCycles);
+    if (usesPowRoutine) {
+        printf("%5s %6d %6d %8d  RT_POW (pior caso por chamada)\n", "-", powRoutineCost.instructions,
+               powRoutineCost.dataCount, powWorstCycles);
+        printf("%5s %6d %6d %8d  RT_MUL (pior caso por chamada)\n", "-", mulRoutineCost.instructions,
+               mulRoutineCost.dataCount, mulWorstCycles);
+    }
+}
+
+int programCycles() {
+    int total = 0;
+    for (int i = 0; i < reportCount; i++)
+        total += estimatedCycles(&reports[i].cost);
+    return total;
+}
+
+bool checkBudget(const Budget* budget) {
+    bool ok = true;
+    for (int i = 0; i < reportCount; i++) {
+        const StatementReport* r = &reports[i];
+        if (budget->stmtInstructions > 0 && r->cost.instructions > budget->stmtInstructions) {
+            fprintf(stderr, "Erro: linha %d (%s) usa %d instruções, orçamento %d\n",
+                    r->line, r->text, r->cost.instructions, budget->stmtInstructions);
+            ok = false;
+        }
+        if (budget->stmtCycles > 0 && estimatedCycles(&r->cost) > budget->stmtCycles) {
+            fprintf(stderr, "Erro: linha %d (%s) usa %d ciclos, orçamento %d\n",
+                    r->line, r->text, estimatedCycles(&r->cost), budget->stmtCycles);
+            ok = false;
+        }
+    }
+    if (budget->instructions > 0 && programInstructions > budget->instructions) {
+        fprintf(stderr, "Erro: programa usa %d instruções, orçamento %d\n", programInstructions, budget->instructions);
+        ok = false;
+    }
+    if (budget->data > 0 && programDataCount > budget->data) {
+        fprintf(stderr, "Erro: programa usa %d palavras de dados, orçamento %d\n", programDataCount, budget->data);
+        ok = false;
+    }
+    if (budget->cycles > 0 && programCycles() > budget->cycles) {
+        fprintf(stderr, "Erro: programa usa %d ciclos, orçamento %d\n", programCycles(), budget->cycles);
+        ok = false;
+    }
+    return ok;
+}
+
+void genRuntime() {
+    int loopStart, loopCycles;
+    if (usesDivRoutine) {
+        memset(&divRoutineCost, 0, sizeof(Cost));
+        currentCost = &divRoutineCost;
+        emitLabel("RT_DIV");
+        emit("LDA", "CONST_0");
+        emit("STA", "RT_Q");
+        emit("LDA", "RT_Y");
+        emit("JMZ", "RT_DIV_RET");
+        loopStart = divRoutineCost.cycles;
+        /*
+         * X >= Y sem sinal: com o bit 7 igual, X - Y não estoura e o sinal
+         * decide; com o bit 7 diferente, o maior é o que tem o bit ligado.
+         */
+        emitLabel("RT_DIV_LOOP");
+        emit("LDA", "RT_X");
+        emit("JMN", "RT_DIV_XHI");
+        emit("LDA", "RT_Y");
+        emit("JMN", "RT_DIV_RET");
+        emit("JMP", "RT_DIV_CMP");
+        emitLabel("RT_DIV_XHI");
+        emit("LDA", "RT_Y");
+        emit("JMN", "RT_DIV_CMP");
+        emit("LDA", "RT_X");
+        emit("SUB", "RT_Y");
+        emit("JMP", "RT_DIV_TAKE");
+        emitLabel("RT_DIV_CMP");
+        emit("LDA", "RT_X");
+        emit("SUB", "RT_Y");
+        emit("JMN", "RT_DIV_RET");
+        emitLabel("RT_DIV_TAKE");
+        emit("STA", "RT_X");
+        emit("LDA", "RT_Q");
+        emit("ADD", "ONE");
+        emit("STA", "RT_Q");
+        emit("JMP", "RT_DIV_LOOP");
+        loopCycles = divRoutineCost.cycles - loopStart;
+        emitLabel("RT_DIV_RET");
+        emit("JMP", "RT_DIV_RET");
+        divWorstCycles = divRoutineCost.cycles + (DIV_ITERATIONS - 1) * loopCycles;
+    }
+    if (usesPowRoutine) {
+        memset(&powRoutineCost, 0, sizeof(Cost));
+        currentCost = &powRoutineCost;
+        emitLabel("RT_POW");
+        emit("LDA", "ONE");
+        emit("STA", "RT_P");
+        loopStart = powRoutineCost.cycles;
+        emitLabel("RT_POW_LOOP");
+        emit("STA", "RT_PM");
+        emit("LDA", "RT_Y");
+        emit("JMZ", "RT_POW_RET");
+        emit("AND", "RT_PM");
+        emit("JMZ", "RT_POW_SQR");
+        emit("LDA", "RT_Y");
+        emit("SUB", "RT_PM");
+        emit("STA", "RT_Y");
+        emit("LDA", "RT_P");
+        emit("STA", "RT_MA");
+        emit("LDA", "RT_X");
+        emit("STA", "RT_MB");
+        genRoutineCall("RT_MUL");
+        emit("STA", "RT_P");
+        emitLabel("RT_POW_SQR");
+        emit("LDA", "RT_X");
+        emit("STA", "RT_MA");
+        emit("STA", "RT_MB");
+        genRoutineCall("RT_MUL");
+        emit("STA", "RT_X");
+        emit("LDA", "RT_PM");
+        emit("ADD", "RT_PM");
+        emit("JMP", "RT_POW_LOOP");
+        int powLoopCycles = powRoutineCost.cycles - loopStart;
+        emitLabel("RT_POW_RET");
+        emit("JMP", "RT_POW_RET");
+
+        memset(&mulRoutineCost, 0, sizeof(Cost));
+        currentCost = &mulRoutineCost;
+        emitLabel("RT_MUL");
+        emit("LDA", "CONST_0");
+        emit("STA", "RT_MP");
+        emit("LDA", "ONE");
+        loopStart = mulRoutineCost.cycles;
+        emitLabel("RT_MUL_LOOP");
+        emit("STA", "RT_MM");
+        emit("AND", "RT_MB");
+        emit("JMZ", "RT_MUL_NEXT");
+        emit("LDA", "RT_MP");
+        emit("ADD", "RT_MA");
+        emit("STA", "RT_MP");
+        emitLabel("RT_MUL_NEXT");
+        emit("LDA", "RT_MA");
+        emit("ADD", "RT_MA");
+        emit("STA", "RT_MA");
+        emit("LDA", "RT_MM");
+        emit("ADD", "RT_MM");
+        emit("JMZ", "RT_MUL_END");
+        emit("JMP", "RT_MUL_LOOP");
+        loopCycles = mulRoutineCost.cycles - loopStart;
+        emitLabel("RT_MUL_END");
+        emit("LDA", "RT_MP");
+        emitLabel("RT_MUL_RET");
+        emit("JMP", "RT_MUL_RET");
+
+        mulWorstCycles = mulRoutineCost.cycles + (MUL_ITERATIONS - 1) * loopCycles;
+        powWorstCycles = powRoutineCost.cycles + (POW_ITERATIONS - 1) * powLoopCycles
+                       + powRoutineCost.mulCalls * POW_ITERATIONS * mulWorstCycles;
+    }
+    currentCost = NULL;
+}
+
+void genTrailingData(int firstVar) {
+    bool hasLateConstants = false;
+    for (int i = firstVar; i < varCount; i++) {
+        if (strncmp(varTable[i].name, "CONST_", 6) == 0)
+            hasLateConstants = true;
+    }
+    if (!hasLateConstants && !usesDivRoutine && !usesPowRoutine)
+        return;
+
+    fprintf(asmOut, "\n.DATA\n");
+    for (int i = firstVar; i < varCount; i++) {
+        if (strncmp(varTable[i].name, "CONST_", 6) == 0)
+            emitDataValue(varTable[i].name, varTable[i].value);
+    }
+    if (!usesDivRoutine && !usesPowRoutine)
+        return;
+
+    emitData("RT_X", "?");
+    emitData("RT_Y", "?");
+    if (usesDivRoutine)
+        emitData("RT_Q", "?");
+    if (usesPowRoutine) {
+        emitData("RT_P", "?");
+        emitData("RT_PM", "?");
+        emitData("RT_MA", "?");
+        emitData("RT_MB", "?");
+        emitData("RT_MP", "?");
+        emitData("RT_MM", "?");
+    }
+    for (int i = 0; i < callCount; i++)
+    {
+        char name[64], label[64];
+        sprintf(name, "RT_RETADDR_%d", i);
+        sprintf(label, "RT_RET_%d", i);
+        emitData(name, label);
+    }
 }
 
 void genExpr(ASTNode* node) {
@@ -439,108 +998,108 @@ void genExpr(ASTNode* node) {
         char constName[64];
         sprintf(constName, "CONST_%d", node->num);
         ensureConstantExists(node->num);
-        fprintf(asmOut, "LDA %s\n", constName);
+        emit("LDA", constName);
     } else if (node->type == AST_VAR) {
         addVar(node->var);
-        fprintf(asmOut, "LDA %s\n", node->var);
+        emit("LDA", node->var);
     } else if (node->type == AST_BINOP) {
         char op = node->binop.op;
         if (op == '+') {
             if (node->binop.left->type == AST_VAR && node->binop.right->type == AST_VAR) {
-                fprintf(asmOut, "LDA %s\n", node->binop.left->var);
-                fprintf(asmOut, "ADD %s\n", node->binop.right->var);
+                emit("LDA", node->binop.left->var);
+                emit("ADD", node->binop.right->var);
             } else if (node->binop.left->type == AST_VAR && node->binop.right->type == AST_NUM) {
                 char constName[64];
                 sprintf(constName, "CONST_%d", node->binop.right->num);
                 ensureConstantExists(node->binop.right->num);
-                fprintf(asmOut, "LDA %s\n", node->binop.left->var);
-                fprintf(asmOut, "ADD %s\n", constName);
+                emit("LDA", node->binop.left->var);
+                emit("ADD", constName);
             } else if (node->binop.left->type == AST_NUM && node->binop.right->type == AST_VAR) {
                 char constName[64];
                 sprintf(constName, "CONST_%d", node->binop.left->num);
                 ensureConstantExists(node->binop.left->num);
-                fprintf(asmOut, "LDA %s\n", constName);
-                fprintf(asmOut, "ADD %s\n", node->binop.right->var);
+                emit("LDA", constName);
+                emit("ADD", node->binop.right->var);
             } else if (node->binop.left->type == AST_NUM && node->binop.right->type == AST_NUM) {
                 int result = node->binop.left->num + node->binop.right->num;
                 char constName[64];
                 sprintf(constName, "CONST_%d", result);
                 ensureConstantExists(result);
-                fprintf(asmOut, "LDA %s\n", constName);
+                emit("LDA", constName);
             } else {
                 genExpr(node->binop.left);
                 if (node->binop.right->type == AST_VAR) {
-                    fprintf(asmOut, "ADD %s\n", node->binop.right->var);
+                    emit("ADD", node->binop.right->var);
                 } else if (node->binop.right->type == AST_NUM) {
                     char constName[64];
                     sprintf(constName, "CONST_%d", node->binop.right->num);
                     ensureConstantExists(node->binop.right->num);
-                    fprintf(asmOut, "ADD %s\n", constName);
+                    emit("ADD", constName);
                 } else {
                     newTemp(tempBuffer);
-                    fprintf(asmOut, "STA %s\n", tempBuffer);
+                    emit("STA", tempBuffer);
 
                     genExpr(node->binop.right);
 
-                    fprintf(asmOut, "ADD %s\n", tempBuffer);
+                    emit("ADD", tempBuffer);
                 }
             }
         } else if (op == '-') {
             if (node->binop.left->type == AST_VAR && node->binop.right->type == AST_VAR) {
-                fprintf(asmOut, "LDA %s\n", node->binop.left->var);
-                fprintf(asmOut, "SUB %s\n", node->binop.right->var);
+                emit("LDA", node->binop.left->var);
+                emit("SUB", node->binop.right->var);
             } else if (node->binop.left->type == AST_VAR && node->binop.right->type == AST_NUM) {
                 char constName[64];
                 sprintf(constName, "CONST_%d", node->binop.right->num);
                 ensureConstantExists(node->binop.right->num);
-                fprintf(asmOut, "LDA %s\n", node->binop.left->var);
-                fprintf(asmOut, "SUB %s\n", constName);
+                emit("LDA", node->binop.left->var);
+                emit("SUB", constName);
             } else if (node->binop.left->type == AST_NUM && node->binop.right->type == AST_VAR) {
                 char constName[64];
                 sprintf(constName, "CONST_%d", node->binop.left->num);
                 ensureConstantExists(node->binop.left->num);
-                fprintf(asmOut, "LDA %s\n", constName);
-                fprintf(asmOut, "SUB %s\n", node->binop.right->var);
+                emit("LDA", constName);
+                emit("SUB", node->binop.right->var);
             } else if (node->binop.left->type == AST_NUM && node->binop.right->type == AST_NUM) {
                 int result = node->binop.left->num - node->binop.right->num;
                 char constName[64];
                 sprintf(constName, "CONST_%d", result);
                 ensureConstantExists(result);
-                fprintf(asmOut, "LDA %s\n", constName);
+                emit("LDA", constName);
             } else {
                 genExpr(node->binop.left);
                 if (node->binop.right->type == AST_VAR) {
-                    fprintf(asmOut, "SUB %s\n", node->binop.right->var);
+                    emit("SUB", node->binop.right->var);
                 } else if (node->binop.right->type == AST_NUM) {
                     char constName[64];
                     sprintf(constName, "CONST_%d", node->binop.right->num);
                     ensureConstantExists(node->binop.right->num);
-                    fprintf(asmOut, "SUB %s\n", constName);
+                    emit("SUB", constName);
                 } else {
                     newTemp(tempBuffer);
-                    fprintf(asmOut, "STA %s\n", tempBuffer);
+                    emit("STA", tempBuffer);
                     genExpr(node->binop.right);
 
                     char rightTemp[64];
                     newTemp(rightTemp);
-                    fprintf(asmOut, "STA %s\n", rightTemp);
+                    emit("STA", rightTemp);
                     
-                    fprintf(asmOut, "LDA %s\n", tempBuffer);
-                    fprintf(asmOut, "SUB %s\n", rightTemp);
+                    emit("LDA", tempBuffer);
+                    emit("SUB", rightTemp);
                 }
             }
         } else if (op == '*') {
             char tempResult[64];
             newTemp(tempResult);
-            fprintf(asmOut, "LDA CONST_0\n");
-            fprintf(asmOut, "STA %s\n", tempResult);
+            emit("LDA", "CONST_0");
+            emit("STA", tempResult);
 
             if (node->binop.right->type == AST_NUM) {
                 int multiplier = node->binop.right->num;
                 for (int i = 0; i < multiplier; i++) {
                     genExpr(node->binop.left);
-                    fprintf(asmOut, "ADD %s\n", tempResult);
-                    fprintf(asmOut, "STA %s\n", tempResult);
+                    emit("ADD", tempResult);
+                    emit("STA", tempResult);
                 }
             } else if (node->binop.right->type == AST_VAR) {
                 int multiplier = -1;
@@ -553,12 +1112,14 @@ void genExpr(ASTNode* node) {
                 if (multiplier >= 0) {
                     for (int i = 0; i < multiplier; i++) {
                         genExpr(node->binop.left);
-                        fprintf(asmOut, "ADD %s\n", tempResult);
-                        fprintf(asmOut, "STA %s\n", tempResult);
+                        emit("ADD", tempResult);
+                        emit("STA", tempResult);
                     }
                 }
             }
-            fprintf(asmOut, "LDA %s\n", tempResult);
+            emit("LDA", tempResult);
+        } else if (op == '/' || op == '%' || op == '^') {
+            genRuntimeOp(node);
         }
     }
 }
@@ -570,23 +1131,142 @@ void genAssignment(Statement* stmt) {
         char constName[64];
         sprintf(constName, "CONST_%d", stmt->expr->num);
         ensureConstantExists(stmt->expr->num);
-        fprintf(asmOut, "LDA %s\n", constName);
-        fprintf(asmOut, "STA %s\n", stmt->var);
+        emit("LDA", constName);
+        emit("STA", stmt->var);
     } else {
         genExpr(stmt->expr);
         addVar(stmt->var);
-        fprintf(asmOut, "STA %s\n", stmt->var);
+        emit("STA", stmt->var);
+    }
+}
+
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/* O único contexto de que a geração depende é o valor conhecido do multiplicador em x * v */
+uint64_t hashAST(uint64_t hash, ASTNode* node) {
+    if (!node) return hashBytes(hash, "?", 1);
+    hash = hashBytes(hash, &node->type, sizeof(node->type));
+    if (node->type == AST_NUM) return hashBytes(hash, &node->num, sizeof(node->num));
+    if (node->type == AST_VAR) return hashBytes(hash, node->var, strlen(node->var) + 1);
+
+    hash = hashBytes(hash, &node->binop.op, 1);
+    if (node->binop.op == '*' && node->binop.right->type == AST_VAR) {
+        int multiplier = -1;
+        for (int i = 0; i < varCount; i++) {
+            if (strcmp(varTable[i].name, node->binop.right->var) == 0 && varTable[i].defined) {
+                multiplier = varTable[i].value;
+                break;
+            }
+        }
+        hash = hashBytes(hash, &multiplier, sizeof(multiplier));
+    }
+    hash = hashAST(hash, node->binop.left);
+    return hashAST(hash, node->binop.right);
+}
+
+void fragmentPath(Statement* stmt, char* path, size_t size) {
+    uint64_t hash = hashBytes(0xcbf29ce484222325ull, CACHE_VERSION, sizeof(CACHE_VERSION));
+    hash = hashBytes(hash, stmt->var, strlen(stmt->var) + 1);
+    hash = hashAST(hash, stmt->expr);
+    snprintf(path, size, "%s/%016llx.frag", cacheDir, (unsigned long long)hash);
+}
+
+bool replayFragment(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* buffer = malloc(size + 1);
+    size_t bytesRead = fread(buffer, 1, size, fp);
+    buffer[bytesRead] = '\0';
+    fclose(fp);
+    /* fragmento incompleto conta como ausente */
+    if (bytesRead < 2 || strcmp(buffer + bytesRead - 2, "E\n") != 0) {
+        free(buffer);
+        return false;
+    }
+
+    int tempBase = tempCount;
+    for (char* line = strtok(buffer, "\n"); line; line = strtok(NULL, "\n")) {
+        char name[64], operand[64];
+        int value;
+        char tempName[64];
+        switch (line[0]) {
+            case 'I':
+                if (sscanf(line, "I %63s %63s", name, operand) != 2) break;
+                if (operand[0] == '@') {
+                    sprintf(tempName, "TEMP_%d", tempBase + atoi(operand + 1));
+                    emit(name, tempName);
+                } else {
+                    emit(name, strcmp(operand, "-") == 0 ? NULL : operand);
+                }
+                break;
+            case 'V':
+                if (sscanf(line, "V %63s", name) == 1) addVar(name);
+                break;
+            case 'U':
+                if (sscanf(line, "U %63s %d", name, &value) == 2) updateVarValue(name, value);
+                break;
+            case 'K':
+                if (sscanf(line, "K %d", &value) == 1) ensureConstantExists(value);
+                break;
+            case 'T':
+                newTemp(tempName);
+                break;
+            case 'C':
+                if (sscanf(line, "C %63s", name) != 1) break;
+                if (strcmp(name, "RT_POW") == 0) usesPowRoutine = true;
+                else usesDivRoutine = true;
+                genRoutineCall(name);
+                break;
+        }
+    }
+    free(buffer);
+    return true;
+}
+
+void compileStatement(Statement* stmt) {
+    if (!cacheDir) {
+        genAssignment(stmt);
+        return;
+    }
+
+    char path[512], tempPath[600];
+    fragmentPath(stmt, path, sizeof(path));
+    if (replayFragment(path)) {
+        cacheHits++;
+        return;
+    }
+    cacheMisses++;
+
+    snprintf(tempPath, sizeof(tempPath), "%s.%d.%d", path, (int)getpid(), workerId);
+    fragmentOut = fopen(tempPath, "w");
+    fragmentTempBase = tempCount;
+    genAssignment(stmt);
+    if (fragmentOut) {
+        fprintf(fragmentOut, "E\n");
+        fclose(fragmentOut);
+        fragmentOut = NULL;
+        rename(tempPath, path);
     }
 }
 
 void generateAssembly() {
     fprintf(asmOut, ".DATA\n");
 
-    fprintf(asmOut, "ONE DB 1\n");
-    fprintf(asmOut, "CONST_0 DB 0\n");
-    fprintf(asmOut, "CONST_1 DB 1\n");
-    fprintf(asmOut, "NEG_1 DB 255\n");
-    fprintf(asmOut, "RES DB ?\n");
+    emitData("ONE", "1");
+    emitData("CONST_0", "0");
+    emitData("CONST_1", "1");
+    emitData("NEG_1", "255");
+    emitData("RES", "?");
     
     Statement* stmt = statements;
     while (stmt) {
@@ -605,58 +1285,46 @@ void generateAssembly() {
             continue;
         
         if (strncmp(varTable[i].name, "TEMP_", 5) == 0) {
-            fprintf(asmOut, "%s DB ?\n", varTable[i].name);
+            emitData(varTable[i].name, "?");
         } else if (strncmp(varTable[i].name, "CONST_", 6) == 0) {
-            fprintf(asmOut, "%s DB %d\n", varTable[i].name, varTable[i].value);
+            emitDataValue(varTable[i].name, varTable[i].value);
         } else if (!varTable[i].defined) {
-            fprintf(asmOut, "%s DB ?\n", varTable[i].name);
+            emitData(varTable[i].name, "?");
         } else {
-            fprintf(asmOut, "%s DB %d\n", varTable[i].name, varTable[i].value);
+            emitDataValue(varTable[i].name, varTable[i].value);
         }
     }
     
+    int declaredVars = varCount;
+
     fprintf(asmOut, "\n.CODE\n");
     fprintf(asmOut, ".ORG 0\n");
     
     stmt = statements;
     while (stmt) {
-        genAssignment(stmt);
+        currentCost = newReport(stmt->line, stmt->var, stmt->expr);
+        compileStatement(stmt);
         stmt = stmt->next;
     }
+    currentCost = newReport(program.resultLine, "RES", program.resultExpr);
     genExpr(program.resultExpr);
-    fprintf(asmOut, "STA RES\n");
-    fprintf(asmOut, "HLT\n");
+    emit("STA", "RES");
+    emit("HLT", NULL);
+    currentCost = NULL;
+    genRuntime();
+    genTrailingData(declaredVars);
 }
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        printf("Uso: %s programa.lpn\n", argv[0]);
-        return 1;
-    }
-
-    FILE* fp = fopen(argv[1], "r");
-    if (!fp) {
-        perror("Erro ao abrir o arquivo .lpn");
-        return 1;
-    }
-
-    fseek(fp, 0, SEEK_END);
-    long fileSize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    source = (char*)malloc(fileSize + 1);
-    if (!source) {
-        perror("Erro ao alocar memória");
-        fclose(fp);
-        return 1;
-    }
-
-    size_t bytesRead = fread(source, 1, fileSize, fp);
-    source[bytesRead] = '\0';
-    fclose(fp);
+typedef struct {
+    bool showReport;
+    bool useBudget;
+    Budget budget;
+} CompileOptions;
 
+/* Compila source (conteúdo de inputFile) para o .asm de mesmo nome; retorna o código de saída */
+int compileSource(const char* inputFile, char* text, const CompileOptions* options) {
     char outputFile[256];
-    strncpy(outputFile, argv[1], sizeof(outputFile)-5);
+    strncpy(outputFile, inputFile, sizeof(outputFile)-5);
     outputFile[sizeof(outputFile)-5] = '\0';
     char* dot = strrchr(outputFile, '.');
     if (dot) *dot = '\0';
@@ -665,23 +1333,297 @@ int main(int argc, char **argv) {
     asmOut = fopen(outputFile, "w");
     if (!asmOut) {
         perror("Erro ao criar arquivo de saída .asm");
-        free(source);
         return 1;
     }
 
+    source = text;
+    sourcePos = 0;
+    sourceLine = 1;
+    tokenCount = 0;
+    currentToken = 0;
+    pendingCount = 0;
     statements = NULL;
     lastStmt = NULL;
+    memset(&program, 0, sizeof(program));
     varCount = 0;
     tempCount = 0;
+    callCount = 0;
+    usesDivRoutine = false;
+    usesPowRoutine = false;
+    reports = NULL;
+    reportCount = 0;
+    programInstructions = 0;
+    programDataCount = 0;
+    cacheHits = 0;
+    cacheMisses = 0;
 
+    jmp_buf abortPoint;
+    if (setjmp(abortPoint)) {
+        compileAbort = NULL;
+        freeStatements(statements);
+        freeAST(program.resultExpr);
+        while (pendingCount > 0) freeAST(pendingNodes[--pendingCount]);
+        fclose(asmOut);
+        remove(outputFile);
+        free(reports);
+        return 1;
+    }
+    compileAbort = &abortPoint;
+
+    StatStage stage;
+    stat_begin(&stage, "tokenize");
     tokenize();
+    stat_end(&stage);
+    stat_begin(&stage, "parseProgram");
     parseProgram();
+    stat_end(&stage);
+    stat_begin(&stage, "generateAssembly");
     generateAssembly();
+    stat_end(&stage);
+    compileAbort = NULL;
+    if (statsEnabled && cacheDir)
+        fprintf(stderr, "stat cache hits=%d misses=%d\n", cacheHits, cacheMisses);
     
     freeStatements(statements);
     freeAST(program.resultExpr);
-    free(source);
     fclose(asmOut);
 
-    return 0;
-}
\ No newline at end of file
+    if (options->showReport) {
+        printReport();
+        printf("Total: %d instruções, %d palavras de dados, %d ciclos estimados\n",
+               programInstructions, programDataCount, programCycles());
+    }
+    int status = 0;
+    if (options->useBudget && !checkBudget(&options->budget)) {
+        remove(outputFile);
+        status = 1;
+    } else if (programInstructions > STANDARD_CODE_INSTRUCTIONS || programDataCount > STANDARD_DATA_WORDS) {
+        /* sem --budget o .asm é mantido, mas só monta com --packed ou --extended */
+        fprintf(stderr, "Aviso: %s usa %d instruções e %d palavras de dados; o formato padrão comporta %d e %d "
+                "(monte com --packed ou --extended)\n", inputFile, programInstructions, programDataCount,
+                STANDARD_CODE_INSTRUCTIONS, STANDARD_DATA_WORDS);
+    }
+    free(reports);
+    return status;
+}
+
+char* readSource(const char* inputFile, size_t* size) {
+    FILE* fp = fopen(inputFile, "r");
+    if (!fp) {
+        perror("Erro ao abrir o arquivo .lpn");
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long fileSize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char* text = (char*)malloc(fileSize + 1);
+    if (!text) {
+        perror("Erro ao alocar memória");
+        fclose(fp);
+        return NULL;
+    }
+
+    size_t bytesRead = fread(text, 1, fileSize, fp);
+    text[bytesRead] = '\0';
+    fclose(fp);
+    if (size) *size = bytesRead;
+    return text;
+}
+
+/*
+ * Modo lote: vários .lpn compilados por um conjunto de threads no mesmo
+ * processo. Fontes com o mesmo conteúdo (mesmo hash) são compiladas uma vez
+ * e o .asm gerado é copiado para as demais.
+ */
+typedef struct {
+    const char* path;
+    char* text;
+    size_t size;
+    uint64_t hash;
+    int original;
+    int status;
+} BatchEntry;
+
+BatchEntry* batchEntries = NULL;
+int batchCount = 0;
+int batchNext = 0;
+const CompileOptions* batchOptions = NULL;
+
+void* batchWorker(void* arg) {
+    workerId = (int)(intptr_t)arg;
+    int i;
+    while ((i = __atomic_fetch_add(&batchNext, 1, __ATOMIC_RELAXED)) < batchCount) {
+        BatchEntry* entry = &batchEntries[i];
+        if (entry->original >= 0 || !entry->text) continue;
+        StatStage stage;
+        char name[300];
+        snprintf(name, sizeof(name), "compile:%s", entry->path);
+        stat_begin(&stage, name);
+        entry->status = compileSource(entry->path, entry->text, batchOptions);
+        stat_end(&stage);
+        if (entry->status != 0)
+            fprintf(stderr, "Erro ao compilar %s\n", entry->path);
+    }
+    return NULL;
+}
+
+/* Entrada das threads do lote; os contadores da thread morrem com ela */
+void* batchThread(void* arg) {
+    batchWorker(arg);
+    stats_close_counters();
+    return NULL;
+}
+
+bool copyOutput(const char* from, const char* to) {
+    char fromAsm[256], toAsm[256];
+    const char* paths[2] = { from, to };
+    char* outputs[2] = { fromAsm, toAsm };
+    for (int i = 0; i < 2; i++) {
+        strncpy(outputs[i], paths[i], 250);
+        outputs[i][250] = '\0';
+        char* dot = strrchr(outputs[i], '.');
+        if (dot) *dot = '\0';
+        strcat(outputs[i], ".asm");
+    }
+    size_t size;
+    char* text = readSource(fromAsm, &size);
+    if (!text) return false;
+    FILE* out = fopen(toAsm, "w");
+    if (out) {
+        fwrite(text, 1, size, out);
+        fclose(out);
+    }
+    free(text);
+    return out != NULL;
+}
+
+int compileBatch(const char** inputs, int count, int jobs, const CompileOptions* options) {
+    batchEntries = calloc(count, sizeof(BatchEntry));
+    batchCount = count;
+    batchNext = 0;
+    batchOptions = options;
+
+    StatStage stage;
+    stat_begin(&stage, "batch.read");
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        BatchEntry* entry = &batchEntries[i];
+        entry->path = inputs[i];
+        entry->original = -1;
+        entry->text = readSource(inputs[i], &entry->size);
+        if (!entry->text) {
+            entry->status = 1;
+            continue;
+        }
+        entry->hash = hashBytes(0xcbf29ce484222325ull, entry->text, entry->size);
+        for (int j = 0; j < i; j++) {
+            BatchEntry* other = &batchEntries[j];
+            if (other->original < 0 && other->text && other->hash == entry->hash &&
+                other->size == entry->size && memcmp(other->text, entry->text, entry->size) == 0) {
+                entry->original = j;
+                break;
+            }
+        }
+        if (entry->original < 0) unique++;
+    }
+    stat_end(&stage);
+
+    if (jobs > unique) jobs = unique > 0 ? unique : 1;
+    stat_begin(&stage, "batch.compile");
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    /* as tabelas do compilador ficam no TLS de cada thread */
+    pthread_attr_setstacksize(&attr, 64 << 20);
+    pthread_t* threads = malloc(jobs * sizeof(pthread_t));
+    int started = 0;
+    for (int t = 0; t < jobs; t++) {
+        int err = pthread_create(&threads[started], &attr, batchThread, (void*)(intptr_t)t);
+        if (err) {
+            fprintf(stderr, "Falha ao criar thread de compilação: %s\n", strerror(err));
+            break;
+        }
+        started++;
+    }
+    /* as threads criadas esvaziam a fila sozinhas; sem nenhuma, o lote roda aqui */
+    if (started == 0) batchWorker((void*)(intptr_t)0);
+    for (int t = 0; t < started; t++)
+        pthread_join(threads[t], NULL);
+    pthread_attr_destroy(&attr);
+    free(threads);
+    stat_end(&stage);
+
+    stat_begin(&stage, "batch.copy");
+    int failures = 0;
+    for (int i = 0; i < count; i++) {
+        BatchEntry* entry = &batchEntries[i];
+        if (entry->original >= 0) {
+            entry->status = batchEntries[entry->original].status;
+            if (entry->status == 0 && !copyOutput(batchEntries[entry->original].path, entry->path))
+                entry->status = 1;
+        }
+        if (entry->status != 0) failures++;
+        free(entry->text);
+    }
+    stat_end(&stage);
+    if (statsEnabled)
+        fprintf(stderr, "stat batch files=%d unique=%d jobs=%d failures=%d\n", count, unique, jobs, failures);
+
+    free(batchEntries);
+    batchEntries = NULL;
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    const char** inputs = malloc(argc * sizeof(char*));
+    int inputCount = 0;
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    CompileOptions options = { false, false, { STANDARD_CODE_INSTRUCTIONS, STANDARD_DATA_WORDS, 0, 0, 0 } };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            statsEnabled = true;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--report") == 0) {
+            options.showReport = true;
+        } else if (strcmp(argv[i], "--budget") == 0) {
+            options.useBudget = true;
+            if (i + 1 < argc && strchr(argv[i + 1], '=') && !parseBudget(argv[++i], &options.budget)) {
+                printf("Orçamento inválido: %s\n", argv[i]);
+                free(inputs);
+                return 1;
+            }
+        } else {
+            inputs[inputCount++] = argv[i];
+        }
+    }
+    if (inputCount == 0) {
+        printf("Uso: %s [--stats] [--report] [--cache dir] [-j N] [--budget [instr=N,data=N,cycles=N,stmt-instr=N,stmt-cycles=N]] programa.lpn...\n", argv[0]);
+        free(inputs);
+        return 1;
+    }
+
+    if (cacheDir && mkdir(cacheDir, 0755) != 0 && access(cacheDir, W_OK) != 0) {
+        perror("Erro ao criar diretório de cache");
+        cacheDir = NULL;
+    }
+
+    int status;
+    if (inputCount == 1) {
+        char* text = readSource(inputs[0], NULL);
+        status = text ? compileSource(inputs[0], text, &options) : 1;
+        free(text);
+    } else {
+        if (options.showReport) {
+            printf("--report só é aceito com um arquivo\n");
+            free(inputs);
+            return 1;
+        }
+        status = compileBatch(inputs, inputCount, jobs > 0 ? jobs : 1, &options);
+    }
+    free(inputs);
+    return status;
+}
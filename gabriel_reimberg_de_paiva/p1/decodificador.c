@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "neander.h"
+
+#define MAX_MAP_SYMBOLS 4096
+
+typedef struct {
+    char name[64];
+    int word;
+    int words;
+    bool code;
+} MapSymbol;
+
+MapSymbol symbols[MAX_MAP_SYMBOLS];
+int symbolCount = 0;
+
+uint32_t readU16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t readU32(const uint8_t *p) {
+    return readU16(p) | (readU16(p + 2) << 16);
+}
+
+const char *mnemonicName(uint8_t opcode) {
+    switch (opcode) {
+        case OPCODE_NOP: return "NOP";
+        case OPCODE_STA: return "STA";
+        case OPCODE_LDA: return "LDA";
+        case OPCODE_ADD: return "ADD";
+        case OPCODE_SUB: return "SUB";
+        case OPCODE_OR:  return "OR";
+        case OPCODE_AND: return "AND";
+        case OPCODE_NOT: return "NOT";
+        case OPCODE_JMP: return "JMP";
+        case OPCODE_JMN: return "JMN";
+        case OPCODE_JMZ: return "JMZ";
+        case OPCODE_HLT: return "HLT";
+        default:         return "???";
+    }
+}
+
+bool hasOperand(uint8_t opcode) {
+    return opcode != OPCODE_NOP && opcode != OPCODE_NOT && opcode != OPCODE_HLT;
+}
+
+/* Lê o mapa do assembler (--map); externos não têm palavra e ficam de fora */
+bool loadMap(const char *path, int bytesPerWord) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) && symbolCount < MAX_MAP_SYMBOLS) {
+        if (line[0] == '#') continue;
+        MapSymbol *sym = &symbols[symbolCount];
+        unsigned offset;
+        int size;
+        char kind[16];
+        if (sscanf(line, "%63s %d %x %d %15s", sym->name, &sym->word, &offset, &size, kind) != 5) continue;
+        sym->code = strcmp(kind, "codigo") == 0;
+        sym->words = size / bytesPerWord > 0 ? size / bytesPerWord : 1;
+        symbolCount++;
+    }
+    fclose(file);
+    return true;
+}
+
+/* Símbolo do tipo pedido que cobre a palavra, como NOME ou NOME+k */
+void symbolFor(int word, bool code, char *out, size_t size) {
+    const MapSymbol *best = NULL;
+    for (int i = 0; i < symbolCount; i++) {
+        const MapSymbol *sym = &symbols[i];
+        if (sym->code != code || word < sym->word || word >= sym->word + sym->words) continue;
+        if (!best || sym->word > best->word) best = sym;
+    }
+    if (!best) out[0] = '\0';
+    else if (best->word == word) snprintf(out, size, "%s", best->name);
+    else snprintf(out, size, "%s+%d", best->name, word - best->word);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Uso: %s rastro.ntr [programa.map]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+        perror(argv[1]);
+        return 1;
+    }
+    uint8_t header[TRACE_FIXEDSIZE];
+    const uint8_t traceHeader[] = HEADER_TRACE;
+    if (fread(header, 1, TRACE_FIXEDSIZE, file) != TRACE_FIXEDSIZE ||
+        memcmp(header, traceHeader, HEADERSIZE) != 0 ||
+        readU16(header + HEADERSIZE + 2) != TRACE_ENTRYSIZE || header[HEADERSIZE] > 2) {
+        printf("Cabeçalho fora do padrão\n");
+        fclose(file);
+        return 1;
+    }
+
+    int kind = header[HEADERSIZE];
+    uint32_t count = readU32(header + HEADERSIZE + 4);
+    uint64_t firstStep = readU32(header + HEADERSIZE + 8) | ((uint64_t)readU32(header + HEADERSIZE + 12) << 32);
+    const char *kindNames[] = { "padrao", "compacto", "estendido" };
+    int bytesPerWord = kind == 1 ? 1 : 2;
+
+    if (argc > 2 && !loadMap(argv[2], bytesPerWord)) {
+        fclose(file);
+        return 1;
+    }
+
+    printf("# formato %s, %u instruções a partir da %llu\n", kindNames[kind], count,
+           (unsigned long long)firstStep + 1);
+    printf("# %10s  %-6s %-20s %-3s  %-6s %-20s %s\n", "instrucao", "PC", "rotulo", "op", "oper", "simbolo", "AC");
+
+    uint8_t entry[TRACE_ENTRYSIZE];
+    uint32_t decoded = 0;
+    char pcName[80], operandName[80];
+    while (decoded < count && fread(entry, 1, TRACE_ENTRYSIZE, file) == TRACE_ENTRYSIZE) {
+        uint32_t pc = readU16(entry);
+        uint32_t operand = readU16(entry + 2);
+        uint32_t ac = readU16(entry + 4);
+        uint8_t opcode = entry[6];
+
+        /* no formato padrão o PC é deslocamento em bytes da imagem */
+        int pcWord = kind == 0 ? ((int)pc - HEADERSIZE) / 2 : (int)pc;
+        symbolFor(pcWord, true, pcName, sizeof(pcName));
+        operandName[0] = '\0';
+        if (hasOperand(opcode)) {
+            bool jump = opcode == OPCODE_JMP || opcode == OPCODE_JMN || opcode == OPCODE_JMZ;
+            symbolFor((int)operand, jump, operandName, sizeof(operandName));
+        }
+
+        char operandText[8] = "";
+        if (hasOperand(opcode)) snprintf(operandText, sizeof(operandText), "0x%02X", operand);
+        printf("  %10llu  0x%04X %-20s %-3s  %-6s %-20s 0x%02X\n", (unsigned long long)(firstStep + decoded + 1),
+               pc, pcName, mnemonicName(opcode), operandText, operandName, ac);
+        decoded++;
+    }
+    fclose(file);
+
+    if (decoded < count) {
+        printf("Rastro truncado: %u de %u registros\n", decoded, count);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "neander.h"
+
+typedef struct {
+    uint8_t data[PACKED_WORDS * 2 + HEADERSIZE];
+    int size;
+} Image;
+
+void writeU16(FILE *out, uint16_t value) {
+    fputc(value & 0xFF, out);
+    fputc(value >> 8, out);
+}
+
+void writeU32(FILE *out, uint32_t value) {
+    writeU16(out, value & 0xFFFF);
+    writeU16(out, value >> 16);
+}
+
+bool loadImage(const char *path, Image *image) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    image->size = fread(image->data, 1, sizeof(image->data), file);
+    fclose(file);
+
+    const uint8_t standardHeader[] = HEADER_STANDARD;
+    const uint8_t packedHeader[] = HEADER_PACKED;
+    int expected = 0;
+    if (image->size >= HEADERSIZE && memcmp(image->data, standardHeader, HEADERSIZE) == 0)
+        expected = STANDARD_IMAGESIZE;
+    else if (image->size >= HEADERSIZE && memcmp(image->data, packedHeader, HEADERSIZE) == 0)
+        expected = PACKED_IMAGESIZE;
+
+    if (expected == 0 || image->size != expected) {
+        fprintf(stderr, "%s: cabeçalho fora do padrão\n", path);
+        return false;
+    }
+    return true;
+}
+
+int nextNonZero(const uint8_t *body, int size, int from) {
+    while (from < size && body[from] == 0) from++;
+    return from;
+}
+
+long encodeImage(const Image *image, FILE *out) {
+    const uint8_t *body = image->data + HEADERSIZE;
+    int size = image->size - HEADERSIZE;
+    int runs[PACKED_WORDS * 2][2];
+    int runCount = 0;
+
+    int pos = nextNonZero(body, size, 0);
+    while (pos < size) {
+        int start = pos;
+        int end = pos;
+        while (end < size) {
+            int next = nextNonZero(body, size, end);
+            if (next >= size || next - end > BUNDLE_RUN_GAP) break;
+            end = next + 1;
+        }
+        runs[runCount][0] = start;
+        runs[runCount][1] = end - start;
+        runCount++;
+        pos = nextNonZero(body, size, end);
+    }
+
+    long written = HEADERSIZE + 2;
+    fwrite(image->data, 1, HEADERSIZE, out);
+    writeU16(out, runCount);
+    for (int i = 0; i < runCount; i++) {
+        writeU16(out, runs[i][0]);
+        writeU16(out, runs[i][1]);
+        fwrite(body + runs[i][0], 1, runs[i][1], out);
+        written += 4 + runs[i][1];
+    }
+    return written;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Uso: %s pacote.nbd imagem.mem [imagem.mem ...]\n", argv[0]);
+        return 1;
+    }
+
+    int count = argc - 2;
+    FILE *out = fopen(argv[1], "wb");
+    if (!out) {
+        perror("Erro ao criar o pacote");
+        return 1;
+    }
+
+    const uint8_t bundleHeader[] = HEADER_BUNDLE;
+    fwrite(bundleHeader, 1, HEADERSIZE, out);
+    writeU32(out, count);
+    long indexPos = ftell(out);
+    for (int i = 0; i <= count; i++)
+        writeU32(out, 0);
+
+    uint32_t *offsets = malloc((count + 1) * sizeof(uint32_t));
+    long dense = 0;
+    offsets[0] = ftell(out);
+    for (int i = 0; i < count; i++) {
+        Image image;
+        if (!loadImage(argv[i + 2], &image)) {
+            free(offsets);
+            fclose(out);
+            remove(argv[1]);
+            return 1;
+        }
+        dense += image.size;
+        offsets[i + 1] = offsets[i] + encodeImage(&image, out);
+    }
+
+    fseek(out, indexPos, SEEK_SET);
+    for (int i = 0; i <= count; i++)
+        writeU32(out, offsets[i]);
+    fclose(out);
+
+    printf("%s: %d imagens, %u bytes (denso: %ld bytes)\n", argv[1], count, offsets[count], dense);
+    free(offsets);
+    return 0;
+}
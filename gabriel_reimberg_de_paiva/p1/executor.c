@@ -2,48 +2,418 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "neander.h"
+#include "stats.h"
 
 #define MEMORYSIZE 516
 #define LINESIZE 16
-#define HEADERSIZE 4
+
+#define EXIT_BUDGET  3
+#define EXIT_TIMEOUT 4
+#define CLOCK_INTERVAL 4096
+
+uint64_t maxSteps = UINT64_MAX;
+uint64_t timeoutNs = 0;
+uint64_t deadlineNs = 0;
+int clockCountdown = CLOCK_INTERVAL;
+
+typedef enum { OUTPUT_FULL, OUTPUT_REGS, OUTPUT_DIFF, OUTPUT_RAW, OUTPUT_JSON } OutputMode;
+
+OutputMode outputMode = OUTPUT_FULL;
+uint8_t *initialMemory = NULL;
+bool widePc = false;
+
+#define OUTBUFSIZE 65536
+char outBuffer[OUTBUFSIZE];
+size_t outLength = 0;
+
+void out_flush() {
+    fwrite(outBuffer, 1, outLength, stdout);
+    outLength = 0;
+}
+
+void out_bytes(const void *data, size_t size) {
+    if (outLength + size > OUTBUFSIZE) out_flush();
+    if (size > OUTBUFSIZE) {
+        fwrite(data, 1, size, stdout);
+        return;
+    }
+    memcpy(outBuffer + outLength, data, size);
+    outLength += size;
+}
+
+void out_str(const char *str) {
+    out_bytes(str, strlen(str));
+}
+
+void out_hex(unsigned long value, int digits, bool upper) {
+    const char *hex = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char buf[16];
+    for (int i = digits - 1; i >= 0; i--) {
+        buf[i] = hex[value & 0xF];
+        value >>= 4;
+    }
+    out_bytes(buf, digits);
+}
+
+void out_uint(unsigned long long value) {
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%llu", value);
+    out_bytes(buf, len);
+}
 
 void print_memory(uint8_t *mem, size_t size) {
     for (size_t i = 0; i < size; i += LINESIZE) {
-        printf("%08lx:", (unsigned long)i);
+        out_hex(i, 8, false);
+        out_str(":");
         for (int j = 0; j < LINESIZE && i + j < size; j++) {
-            printf(" %02x", mem[i + j]);
+            out_str(" ");
+            out_hex(mem[i + j], 2, false);
         }
-        printf("\n");
+        out_str("\n");
     }
 }
 
-int main() {
-    uint8_t ac = 0, pc = 0;
-    bool z = false, n = false;
-    FILE *file = fopen("programa.mem", "rb");
-    if (!file) {
-        perror("Falha ao abrir .mem");
-        return 1;
+void print_register(const char *name, unsigned value) {
+    out_str("Final ");
+    out_str(name);
+    out_str(": 0x");
+    out_hex(value, value > 0xFF ? 4 : 2, true);
+    out_str("\n");
+}
+
+void remember_initial(const uint8_t *mem, size_t size) {
+    if (outputMode == OUTPUT_DIFF || outputMode == OUTPUT_JSON) {
+        initialMemory = malloc(size);
+        memcpy(initialMemory, mem, size);
     }
+}
 
-    uint8_t bytes[MEMORYSIZE] = {0};
-    uint8_t fileHeader[HEADERSIZE];
-    fread(fileHeader, 1, HEADERSIZE, file);
-    const uint8_t expectedHeader[] = {0x03, 0x4E, 0x44, 0x52};
-    if (memcmp(fileHeader, expectedHeader, HEADERSIZE) != 0) {
-        printf("Cabeçalho fora do padrão\n");
-        fclose(file);
-        return 1;
+void report_state(uint8_t *mem, size_t size, size_t resOffset, uint8_t ac, uint32_t pc, uint64_t steps, int status) {
+    switch (outputMode) {
+        case OUTPUT_FULL:
+            print_memory(mem, size);
+            print_register("AC", ac);
+            print_register("PC", pc);
+            break;
+        case OUTPUT_REGS:
+            print_register("RES", mem[resOffset]);
+            print_register("AC", ac);
+            print_register("PC", pc);
+            break;
+        case OUTPUT_DIFF:
+            for (size_t i = 0; i < size; i++) {
+                if (mem[i] == initialMemory[i]) continue;
+                out_hex(i, 8, false);
+                out_str(": ");
+                out_hex(initialMemory[i], 2, false);
+                out_str(" -> ");
+                out_hex(mem[i], 2, false);
+                out_str("\n");
+            }
+            print_register("AC", ac);
+            print_register("PC", pc);
+            break;
+        case OUTPUT_RAW:
+            out_bytes(mem, size);
+            out_bytes(&ac, 1);
+            for (int i = 0; i < (widePc ? 2 : 1); i++) {
+                uint8_t byte = (uint8_t)(pc >> (8 * i));
+                out_bytes(&byte, 1);
+            }
+            break;
+        case OUTPUT_JSON: {
+            out_str("{\"status\":");
+            out_uint(status);
+            out_str(",\"steps\":");
+            out_uint(steps);
+            out_str(",\"ac\":");
+            out_uint(ac);
+            out_str(",\"pc\":");
+            out_uint(pc);
+            out_str(",\"res\":");
+            out_uint(mem[resOffset]);
+            out_str(",\"diff\":[");
+            bool first = true;
+            for (size_t i = 0; i < size; i++) {
+                if (mem[i] == initialMemory[i]) continue;
+                out_str(first ? "[" : ",[");
+                out_uint(i);
+                out_str(",");
+                out_uint(initialMemory[i]);
+                out_str(",");
+                out_uint(mem[i]);
+                out_str("]");
+                first = false;
+            }
+            out_str("]}\n");
+            break;
+        }
+    }
+    out_flush();
+}
+
+void start_clock() {
+    clockCountdown = CLOCK_INTERVAL;
+    if (timeoutNs) deadlineNs = stats_now_ns() + timeoutNs;
+}
+
+/* Chamada só em saltos para trás e no estouro do PC, únicos caminhos de um laço. */
+int check_limits(uint64_t steps) {
+    if (steps > maxSteps) return EXIT_BUDGET;
+    if (timeoutNs && --clockCountdown == 0) {
+        clockCountdown = CLOCK_INTERVAL;
+        if (stats_now_ns() > deadlineNs) return EXIT_TIMEOUT;
+    }
+    return 0;
+}
+
+typedef enum { IMAGE_STANDARD, IMAGE_PACKED, IMAGE_EXTENDED } ImageKind;
+
+typedef struct {
+    uint16_t ac;
+    uint32_t pc;
+    uint64_t steps;
+} VmState;
+
+const VmState INITIAL_STATE = { 0, 0, 0 };
+
+uint64_t snapshotStep = UINT64_MAX;
+uint32_t snapshotPc = UINT32_MAX;
+const char *snapshotPath = "estado.snap";
+
+#define MAX_PATCHES 64
+uint32_t patchWords[MAX_PATCHES];
+uint16_t patchValues[MAX_PATCHES];
+int patchCount = 0;
+
+void write_u16(FILE *out, uint32_t value) {
+    fputc(value & 0xFF, out);
+    fputc((value >> 8) & 0xFF, out);
+}
+
+void write_u32(FILE *out, uint32_t value) {
+    write_u16(out, value & 0xFFFF);
+    write_u16(out, value >> 16);
+}
+
+/* Grava o estado antes da instrução em pc; a memória vai em trechos não nulos, como no pacote */
+void save_snapshot(ImageKind kind, const uint8_t *mem, size_t size, uint16_t ac, uint32_t pc, bool z, bool n, uint64_t steps) {
+    snapshotStep = UINT64_MAX;
+    snapshotPc = UINT32_MAX;
+    FILE *out = fopen(snapshotPath, "wb");
+    if (!out) {
+        perror("Falha ao criar snapshot");
+        return;
+    }
+    const uint8_t header[] = HEADER_SNAPSHOT;
+    fwrite(header, 1, HEADERSIZE, out);
+    fputc(kind, out);
+    fputc((z ? 1 : 0) | (n ? 2 : 0), out);
+    write_u16(out, ac);
+    write_u32(out, pc);
+    write_u32(out, (uint32_t)steps);
+    write_u32(out, (uint32_t)(steps >> 32));
+    write_u32(out, (uint32_t)size);
+
+    long countPos = ftell(out);
+    write_u32(out, 0);
+    uint32_t runCount = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        while (pos < size && mem[pos] == 0) pos++;
+        if (pos == size) break;
+        size_t end = pos;
+        for (size_t scan = pos; scan < size && scan - end <= BUNDLE_RUN_GAP; scan++) {
+            if (mem[scan] != 0) end = scan + 1;
+        }
+        write_u32(out, (uint32_t)pos);
+        write_u32(out, (uint32_t)(end - pos));
+        fwrite(mem + pos, 1, end - pos, out);
+        runCount++;
+        pos = end;
+    }
+    fseek(out, countPos, SEEK_SET);
+    write_u32(out, runCount);
+    fclose(out);
+    fprintf(stderr, "Snapshot gravado em %s (PC 0x%02X, %llu instruções)\n", snapshotPath, pc, (unsigned long long)steps);
+}
+
+void report_limit(int status, uint64_t steps) {
+    if (status == EXIT_BUDGET)
+        fprintf(stderr, "Execução interrompida: limite de %llu instruções excedido\n", (unsigned long long)maxSteps);
+    else if (status == EXIT_TIMEOUT)
+        fprintf(stderr, "Execução interrompida: tempo limite excedido após %llu instruções\n", (unsigned long long)steps);
+}
+
+/*
+ * Rastro (--trace N): anel de N registros preenchido pelos laços de produção
+ * a cada instrução, ao custo de um desvio previsível e um store de 8 bytes.
+ * Só vai para o disco em interrupção por limite, sinal fatal, SIGUSR1 ou
+ * --trace-dump; a gravação usa apenas open/write para caber num tratador
+ * de sinal. O decodificador lê o arquivo.
+ */
+typedef struct {
+    uint16_t pc;
+    uint16_t operand;
+    uint16_t ac;
+    uint8_t opcode;
+    uint8_t reserved;
+} TraceEntry;
+
+#define TRACE_MAX_ENTRIES (1u << 24)
+
+TraceEntry *traceRing = NULL;
+uint32_t traceEntries = 0;
+uint32_t traceMask = 0;
+volatile uint64_t traceHead = 0;
+uint64_t traceFirstStep = 0;
+ImageKind traceKind = IMAGE_STANDARD;
+const char *tracePath = "rastro.ntr";
+bool traceDump = false;
+
+static inline void trace_record(uint32_t pc, uint8_t opcode, uint32_t operand, uint16_t ac) {
+    uint64_t head = traceHead;
+    TraceEntry *entry = &traceRing[head & traceMask];
+    entry->pc = (uint16_t)pc;
+    entry->operand = (uint16_t)operand;
+    entry->ac = ac;
+    entry->opcode = opcode;
+    traceHead = head + 1;
+}
+
+void put_u16(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+void put_u32(uint8_t *p, uint32_t value) {
+    put_u16(p, value & 0xFFFF);
+    put_u16(p + 2, value >> 16);
+}
+
+bool write_all(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+/* Grava o anel do registro mais antigo ao mais recente; segura em tratador de sinal */
+bool trace_flush(void) {
+    uint64_t head = traceHead;
+    uint64_t count = head < traceEntries ? head : traceEntries;
+    uint64_t first = head - count;
+    int fd = open(tracePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    uint8_t buffer[TRACE_ENTRYSIZE * 512];
+    const uint8_t header[] = HEADER_TRACE;
+    memcpy(buffer, header, HEADERSIZE);
+    buffer[HEADERSIZE] = (uint8_t)traceKind;
+    buffer[HEADERSIZE + 1] = 0;
+    put_u16(buffer + HEADERSIZE + 2, TRACE_ENTRYSIZE);
+    put_u32(buffer + HEADERSIZE + 4, (uint32_t)count);
+    put_u32(buffer + HEADERSIZE + 8, (uint32_t)(traceFirstStep + first));
+    put_u32(buffer + HEADERSIZE + 12, (uint32_t)((traceFirstStep + first) >> 32));
+    bool ok = write_all(fd, buffer, TRACE_FIXEDSIZE);
+
+    size_t used = 0;
+    for (uint64_t i = first; ok && i < head; i++) {
+        const TraceEntry *entry = &traceRing[i & traceMask];
+        uint8_t *p = buffer + used;
+        put_u16(p, entry->pc);
+        put_u16(p + 2, entry->operand);
+        put_u16(p + 4, entry->ac);
+        p[6] = entry->opcode;
+        p[7] = 0;
+        used += TRACE_ENTRYSIZE;
+        if (used == sizeof(buffer) || i + 1 == head) {
+            ok = write_all(fd, buffer, used);
+            used = 0;
+        }
     }
+    return close(fd) == 0 && ok;
+}
+
+void trace_signal(int sig) {
+    int savedErrno = errno;
+    static const char saved[] = "Rastro gravado\n";
+    static const char failed[] = "Falha ao gravar rastro\n";
+    if (trace_flush()) write(STDERR_FILENO, saved, sizeof(saved) - 1);
+    else write(STDERR_FILENO, failed, sizeof(failed) - 1);
+    errno = savedErrno;
+    if (sig == SIGUSR1) return;
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+const int TRACE_SIGNALS[] = { SIGUSR1, SIGINT, SIGTERM, SIGSEGV, SIGBUS, SIGFPE, SIGABRT };
+#define TRACE_SIGNAL_COUNT (sizeof(TRACE_SIGNALS) / sizeof(TRACE_SIGNALS[0]))
+struct sigaction tracePreviousActions[TRACE_SIGNAL_COUNT];
+
+bool trace_start(ImageKind kind, const VmState *start) {
+    traceRing = calloc(traceEntries, sizeof(TraceEntry));
+    if (!traceRing) {
+        printf("Memória insuficiente para o rastro\n");
+        return false;
+    }
+    traceMask = traceEntries - 1;
+    traceHead = 0;
+    traceFirstStep = start->steps;
+    traceKind = kind;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = trace_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    for (size_t i = 0; i < TRACE_SIGNAL_COUNT; i++)
+        sigaction(TRACE_SIGNALS[i], &action, &tracePreviousActions[i]);
+    return true;
+}
 
-    fread(bytes + HEADERSIZE, 1, MEMORYSIZE - HEADERSIZE, file);
-    fclose(file);
+void trace_finish(int status) {
+    for (size_t i = 0; i < TRACE_SIGNAL_COUNT; i++)
+        sigaction(TRACE_SIGNALS[i], &tracePreviousActions[i], NULL);
+    if (status || traceDump) {
+        if (trace_flush())
+            fprintf(stderr, "Rastro gravado em %s (%llu instruções)\n", tracePath,
+                    (unsigned long long)(traceHead < traceEntries ? traceHead : traceEntries));
+        else
+            perror("Falha ao gravar rastro");
+    }
+    free(traceRing);
+    traceRing = NULL;
+}
 
+int run_standard(uint8_t *bytes, const VmState *start) {
+    uint8_t ac = (uint8_t)start->ac, pc = (uint8_t)start->pc;
+    bool z = false, n = false;
+    uint64_t steps = start->steps;
+    int status = 0;
+
+    StatStage stage;
+    stat_begin(&stage, "execute");
     while (bytes[pc] != 0xF0) {
         z = (ac == 0);
         n = ((ac & 0x80) != 0);
         uint16_t address = bytes[pc + 2] * 2 + HEADERSIZE;
+        if (traceRing) trace_record(pc, bytes[pc], bytes[pc + 2], ac);
+        steps++;
 
         switch (bytes[pc]) {
             case 0x00: break;
@@ -53,19 +423,676 @@ int main() {
             case 0x31: ac -= bytes[address]; break;
             case 0x40: ac |= bytes[address]; break;
             case 0x50: ac &= bytes[address]; break;
-            case 0x60: ac = ~ac; pc += 2; continue;
-            case 0x80: pc = address; continue;
-            case 0x90: if (n) { pc = address; continue; } break;
-            case 0xA0: if (z) { pc = address; continue; } break;
+            case 0x60: ac = ~ac; pc -= 2; break;
+            case 0x80:
+                if ((uint8_t)address <= pc && (status = check_limits(steps))) goto interrupted;
+                pc = address; continue;
+            case 0x90:
+                if (n) {
+                    if ((uint8_t)address <= pc && (status = check_limits(steps))) goto interrupted;
+                    pc = address; continue;
+                }
+                break;
+            case 0xA0:
+                if (z) {
+                    if ((uint8_t)address <= pc && (status = check_limits(steps))) goto interrupted;
+                    pc = address; continue;
+                }
+                break;
             case 0xF0: break;
         }
 
         pc += 4;
+        if (pc < 4 && (status = check_limits(steps))) break;
+    }
+
+interrupted:
+    stat_end(&stage);
+    report_state(bytes, MEMORYSIZE, HEADERSIZE + STANDARD_RESULT_WORD * 2, ac, pc, steps, status);
+    report_limit(status, steps);
+    return status;
+}
+
+int run_packed(uint8_t *mem, const VmState *start) {
+    uint8_t ac = (uint8_t)start->ac, pc = (uint8_t)start->pc;
+    bool z = false, n = false;
+    uint64_t steps = start->steps;
+    int status = 0;
+
+    StatStage stage;
+    stat_begin(&stage, "execute");
+    while (mem[pc] != 0xF0) {
+        z = (ac == 0);
+        n = ((ac & 0x80) != 0);
+        uint8_t address = mem[(uint8_t)(pc + 1)];
+        if (traceRing) trace_record(pc, mem[pc], address, ac);
+        steps++;
+
+        switch (mem[pc]) {
+            case 0x00: break;
+            case 0x10: mem[address] = ac; break;
+            case 0x20: ac = mem[address]; break;
+            case 0x30: ac += mem[address]; break;
+            case 0x31: ac -= mem[address]; break;
+            case 0x40: ac |= mem[address]; break;
+            case 0x50: ac &= mem[address]; break;
+            case 0x60: ac = ~ac; pc -= 1; break;
+            case 0x80:
+                if (address <= pc && (status = check_limits(steps))) goto interrupted;
+                pc = address; continue;
+            case 0x90:
+                if (n) {
+                    if (address <= pc && (status = check_limits(steps))) goto interrupted;
+                    pc = address; continue;
+                }
+                break;
+            case 0xA0:
+                if (z) {
+                    if (address <= pc && (status = check_limits(steps))) goto interrupted;
+                    pc = address; continue;
+                }
+                break;
+            case 0xF0: break;
+        }
+
+        pc += 2;
+        if (pc < 2 && (status = check_limits(steps))) break;
+    }
+
+interrupted:
+    stat_end(&stage);
+    report_state(mem, PACKED_WORDS, PACKED_RESULT_WORD, ac, pc, steps, status);
+    report_limit(status, steps);
+    return status;
+}
+
+uint32_t read_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t read_u32(const uint8_t *p) {
+    return read_u16(p) | (read_u16(p + 2) << 16);
+}
+
+int run_extended(uint8_t *mem, uint32_t words, const VmState *start) {
+    uint16_t ac = start->ac;
+    uint32_t pc = start->pc < words ? start->pc : 0;
+    bool z = false, n = false;
+    uint64_t steps = start->steps;
+    int status = 0;
+
+    widePc = true;
+    StatStage stage;
+    stat_begin(&stage, "execute");
+    while (mem[pc * 2] != 0xF0) {
+        z = ((uint8_t)ac == 0);
+        n = ((ac & 0x80) != 0);
+        uint32_t address = read_u16(mem + (pc + 1 < words ? pc + 1 : 0) * 2);
+        if (address >= words) address %= words;
+        uint8_t *word = mem + address * 2;
+        if (traceRing) trace_record(pc, mem[pc * 2], address, ac);
+        steps++;
+
+        switch (mem[pc * 2]) {
+            case 0x00: break;
+            case 0x10: word[0] = (uint8_t)ac; word[1] = (uint8_t)(ac >> 8); break;
+            case 0x20: ac = read_u16(word); break;
+            case 0x30: ac = (uint8_t)(ac + word[0]); break;
+            case 0x31: ac = (uint8_t)(ac - word[0]); break;
+            case 0x40: ac = (uint8_t)(ac | word[0]); break;
+            case 0x50: ac = (uint8_t)(ac & word[0]); break;
+            case 0x60: ac = (uint8_t)~ac; pc -= 1; break;
+            case 0x80:
+                if (address <= pc && (status = check_limits(steps))) goto interrupted;
+                pc = address; continue;
+            case 0x90:
+                if (n) {
+                    if (address <= pc && (status = check_limits(steps))) goto interrupted;
+                    pc = address; continue;
+                }
+                break;
+            case 0xA0:
+                if (z) {
+                    if (address <= pc && (status = check_limits(steps))) goto interrupted;
+                    pc = address; continue;
+                }
+                break;
+            case 0xF0: break;
+        }
+
+        pc += 2;
+        if (pc >= words) {
+            pc -= words;
+            if ((status = check_limits(steps))) break;
+        }
+    }
+
+interrupted:
+    stat_end(&stage);
+    report_state(mem, words * 2, (words - 1) * 2, (uint8_t)ac, pc, steps, status);
+    report_limit(status, steps);
+    return status;
+}
+
+/*
+ * Depurador (--debug): laço próprio que reproduz a semântica dos três laços
+ * de produção instrução a instrução, para que eles não paguem nenhuma
+ * verificação extra. PCs seguem a unidade de "Final PC" de cada formato;
+ * palavras seguem os endereços do assembler.
+ */
+bool debugMode = false;
+const char *debugScript = NULL;
+
+typedef struct {
+    ImageKind kind;
+    uint8_t *mem;
+    uint32_t words;
+    uint16_t ac;
+    uint32_t pc;
+    uint64_t steps;
+} Machine;
+
+#define MAX_BREAKPOINTS 32
+
+uint8_t *debug_word(const Machine *m, uint32_t word) {
+    if (m->kind == IMAGE_STANDARD) return m->mem + HEADERSIZE + (word & 0xFF) * 2;
+    if (m->kind == IMAGE_PACKED) return m->mem + (word & 0xFF);
+    return m->mem + (word % m->words) * 2;
+}
+
+uint8_t debug_opcode(const Machine *m) {
+    return m->kind == IMAGE_EXTENDED ? m->mem[m->pc * 2] : m->mem[m->pc];
+}
+
+uint32_t debug_operand(const Machine *m) {
+    if (m->kind == IMAGE_STANDARD) return m->mem[m->pc + 2];
+    if (m->kind == IMAGE_PACKED) return m->mem[(uint8_t)(m->pc + 1)];
+    uint32_t operand = read_u16(m->mem + (m->pc + 1 < m->words ? m->pc + 1 : 0) * 2);
+    return operand < m->words ? operand : operand % m->words;
+}
+
+const char *mnemonic_name(uint8_t opcode) {
+    switch (opcode) {
+        case OPCODE_NOP: return "NOP";
+        case OPCODE_STA: return "STA";
+        case OPCODE_LDA: return "LDA";
+        case OPCODE_ADD: return "ADD";
+        case OPCODE_SUB: return "SUB";
+        case OPCODE_OR:  return "OR";
+        case OPCODE_AND: return "AND";
+        case OPCODE_NOT: return "NOT";
+        case OPCODE_JMP: return "JMP";
+        case OPCODE_JMN: return "JMN";
+        case OPCODE_JMZ: return "JMZ";
+        case OPCODE_HLT: return "HLT";
+        default:         return "???";
     }
+}
+
+void debug_show(const Machine *m) {
+    uint8_t opcode = debug_opcode(m);
+    printf("PC 0x%02X  %-3s 0x%02X  AC 0x%02X  Z %d  N %d  passos %llu\n", m->pc, mnemonic_name(opcode),
+           debug_operand(m), m->ac, (uint8_t)m->ac == 0, (m->ac & 0x80) != 0, (unsigned long long)m->steps);
+}
+
+/* Executa uma instrução; devolve a palavra escrita por STA ou -1 */
+long debug_step(Machine *m) {
+    bool z = ((uint8_t)m->ac == 0);
+    bool n = ((m->ac & 0x80) != 0);
+    uint8_t opcode = debug_opcode(m);
+    uint32_t operand = debug_operand(m);
+    uint8_t *word = debug_word(m, operand);
+    uint32_t target = m->kind == IMAGE_STANDARD ? (uint8_t)(operand * 2 + HEADERSIZE) : operand;
+    uint32_t size = m->kind == IMAGE_STANDARD ? 4 : 2;
+    long stored = -1;
+    m->steps++;
+
+    switch (opcode) {
+        case OPCODE_STA:
+            word[0] = (uint8_t)m->ac;
+            if (m->kind == IMAGE_EXTENDED) word[1] = (uint8_t)(m->ac >> 8);
+            stored = operand;
+            break;
+        case OPCODE_LDA: m->ac = m->kind == IMAGE_EXTENDED ? read_u16(word) : word[0]; break;
+        case OPCODE_ADD: m->ac = (uint8_t)(m->ac + word[0]); break;
+        case OPCODE_SUB: m->ac = (uint8_t)(m->ac - word[0]); break;
+        case OPCODE_OR:  m->ac = (uint8_t)(m->ac | word[0]); break;
+        case OPCODE_AND: m->ac = (uint8_t)(m->ac & word[0]); break;
+        case OPCODE_NOT: m->ac = (uint8_t)~m->ac; m->pc -= size / 2; break;
+        case OPCODE_JMP: m->pc = target; return stored;
+        case OPCODE_JMN: if (n) { m->pc = target; return stored; } break;
+        case OPCODE_JMZ: if (z) { m->pc = target; return stored; } break;
+    }
+    m->pc += size;
+    if (m->kind == IMAGE_EXTENDED) {
+        if (m->pc >= m->words) m->pc -= m->words;
+    } else {
+        m->pc &= 0xFF;
+    }
+    return stored;
+}
 
-    print_memory(bytes, MEMORYSIZE);
+void debug_help() {
+    printf("Comandos:\n"
+           "  s [n]          executa n instruções (padrão 1)\n"
+           "  c              continua até breakpoint, watchpoint ou HLT\n"
+           "  b <pc>         breakpoint no PC       d <pc>   remove o breakpoint\n"
+           "  w <palavra>    watchpoint em STA      u <palavra>  remove o watchpoint\n"
+           "  r              registradores          m <palavra> [n]  mostra n palavras\n"
+           "  q              encerra\n");
+}
 
-    printf("Final AC: 0x%02X\n", ac);
-    printf("Final PC: 0x%02X\n", pc);
+bool remove_value(uint32_t *list, int *count, uint32_t value) {
+    for (int i = 0; i < *count; i++) {
+        if (list[i] == value) {
+            list[i] = list[--(*count)];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool contains_value(const uint32_t *list, int count, uint32_t value) {
+    for (int i = 0; i < count; i++) {
+        if (list[i] == value) return true;
+    }
+    return false;
+}
+
+int run_debug(ImageKind kind, uint8_t *mem, uint32_t words, const VmState *start) {
+    Machine m = { kind, mem, words, start->ac, start->pc, start->steps };
+    uint32_t breakpoints[MAX_BREAKPOINTS], watchpoints[MAX_BREAKPOINTS];
+    int breakpointCount = 0, watchpointCount = 0;
+    size_t size = kind == IMAGE_STANDARD ? MEMORYSIZE : kind == IMAGE_PACKED ? PACKED_WORDS : words * 2;
+    size_t resOffset = debug_word(&m, kind == IMAGE_STANDARD ? STANDARD_RESULT_WORD : words - 1) - mem;
+
+    FILE *input = stdin;
+    if (debugScript && !(input = fopen(debugScript, "r"))) {
+        perror("Falha ao abrir o roteiro do depurador");
+        return 1;
+    }
+    bool interactive = !debugScript && isatty(STDIN_FILENO);
+    widePc = kind == IMAGE_EXTENDED;
+    remember_initial(mem, size);
+    debug_show(&m);
+
+    char line[128];
+    while (debug_opcode(&m) != OPCODE_HLT) {
+        if (interactive) {
+            printf("(neander) ");
+            fflush(stdout);
+        }
+        if (!fgets(line, sizeof(line), input)) break;
+        char command[16] = "";
+        long a = 0, b = 0;
+        int args = sscanf(line, "%15s %li %li", command, &a, &b) - 1;
+        if (args < 0) continue;
+
+        if (strcmp(command, "q") == 0) break;
+        if (strcmp(command, "h") == 0 || strcmp(command, "?") == 0) {
+            debug_help();
+        } else if (strcmp(command, "r") == 0) {
+            debug_show(&m);
+        } else if (strcmp(command, "b") == 0 && args >= 1) {
+            if (breakpointCount < MAX_BREAKPOINTS && !contains_value(breakpoints, breakpointCount, a))
+                breakpoints[breakpointCount++] = a;
+        } else if (strcmp(command, "d") == 0 && args >= 1) {
+            if (!remove_value(breakpoints, &breakpointCount, a)) printf("Sem breakpoint em 0x%02lX\n", (unsigned long)a);
+        } else if (strcmp(command, "w") == 0 && args >= 1) {
+            if (watchpointCount < MAX_BREAKPOINTS && !contains_value(watchpoints, watchpointCount, a))
+                watchpoints[watchpointCount++] = a;
+        } else if (strcmp(command, "u") == 0 && args >= 1) {
+            if (!remove_value(watchpoints, &watchpointCount, a)) printf("Sem watchpoint em %ld\n", a);
+        } else if (strcmp(command, "m") == 0 && args >= 1) {
+            for (long i = 0; i < (args >= 2 ? b : 1); i++) {
+                uint8_t *word = debug_word(&m, a + i);
+                unsigned value = kind == IMAGE_EXTENDED ? read_u16(word) : word[0];
+                printf("[%ld] = 0x%02X (%u)\n", a + i, value, value);
+            }
+        } else if (strcmp(command, "s") == 0 || strcmp(command, "c") == 0) {
+            bool run = command[0] == 'c';
+            long count = run ? LONG_MAX : (args >= 1 ? a : 1);
+            for (long i = 0; i < count && debug_opcode(&m) != OPCODE_HLT; i++) {
+                if (m.steps >= maxSteps) {
+                    printf("Limite de %llu instruções atingido\n", (unsigned long long)maxSteps);
+                    break;
+                }
+                uint32_t watchedOld = 0;
+                uint32_t operand = debug_operand(&m);
+                bool watched = debug_opcode(&m) == OPCODE_STA && contains_value(watchpoints, watchpointCount, operand);
+                if (watched) watchedOld = *debug_word(&m, operand);
+                debug_step(&m);
+                if (watched) {
+                    printf("Watchpoint: [%u] 0x%02X -> 0x%02X\n", operand, watchedOld, *debug_word(&m, operand));
+                    break;
+                }
+                if (run && contains_value(breakpoints, breakpointCount, m.pc)) {
+                    printf("Breakpoint em 0x%02X\n", m.pc);
+                    break;
+                }
+            }
+            debug_show(&m);
+        } else {
+            printf("Comando desconhecido: %s (h para ajuda)\n", command);
+        }
+    }
+    if (input != stdin) fclose(input);
+
+    if (debug_opcode(&m) != OPCODE_HLT) return 0;
+    printf("Programa terminou (HLT)\n");
+    report_state(mem, size, resOffset, (uint8_t)m.ac, m.pc, m.steps, 0);
     return 0;
 }
+
+/*
+ * Snapshot (--snapshot-step/--snapshot-pc): os laços de produção não testam o
+ * ponto pedido. Aqui o passo do depurador leva a VM até ele, grava o estado e
+ * devolve a execução ao laço de produção. Ao chegar ao limite de instruções
+ * ele só entrega a VM, para que o laço de produção interrompa no ponto de sempre.
+ */
+int run_to_snapshot(ImageKind kind, uint8_t *mem, uint32_t words, VmState *state) {
+    Machine m = { kind, mem, words, state->ac, state->pc, state->steps };
+    size_t size = kind == IMAGE_STANDARD ? MEMORYSIZE : kind == IMAGE_PACKED ? PACKED_WORDS : words * 2;
+    int status = 0;
+
+    StatStage stage;
+    stat_begin(&stage, "snapshot");
+    while (debug_opcode(&m) != OPCODE_HLT && m.steps < maxSteps) {
+        if (m.steps == snapshotStep || m.pc == snapshotPc) {
+            save_snapshot(kind, mem, size, m.ac, m.pc, (uint8_t)m.ac == 0, (m.ac & 0x80) != 0, m.steps);
+            break;
+        }
+        if (traceRing) trace_record(m.pc, debug_opcode(&m), debug_operand(&m), m.ac);
+        uint32_t pc = m.pc;
+        debug_step(&m);
+        if (m.pc <= pc && (status = check_limits(m.steps))) break;
+    }
+    stat_end(&stage);
+
+    if (status) {
+        size_t resOffset = debug_word(&m, kind == IMAGE_STANDARD ? STANDARD_RESULT_WORD : words - 1) - mem;
+        widePc = kind == IMAGE_EXTENDED;
+        report_state(mem, size, resOffset, (uint8_t)m.ac, m.pc, m.steps, status);
+        report_limit(status, m.steps);
+    }
+    state->ac = m.ac;
+    state->pc = m.pc;
+    state->steps = m.steps;
+    return status;
+}
+
+/* Da abertura do arquivo até a imagem estar pronta; encerrada pelo primeiro run_image */
+StatStage loadStage;
+
+/* Aplica os --patch (índice de palavra = operando do assembler) e despacha para o laço do formato */
+int run_image(ImageKind kind, uint8_t *mem, uint32_t words, const VmState *start) {
+    stat_end(&loadStage);
+    for (int i = 0; i < patchCount; i++) {
+        uint32_t word = patchWords[i];
+        if (word >= words) {
+            printf("Palavra %u fora da memória\n", word);
+            return 1;
+        }
+        if (kind == IMAGE_STANDARD) {
+            mem[HEADERSIZE + word * 2] = (uint8_t)patchValues[i];
+        } else if (kind == IMAGE_PACKED) {
+            mem[word] = (uint8_t)patchValues[i];
+        } else {
+            mem[word * 2] = (uint8_t)patchValues[i];
+            mem[word * 2 + 1] = (uint8_t)(patchValues[i] >> 8);
+        }
+    }
+    if (debugMode) return run_debug(kind, mem, words, start);
+    if (traceEntries && !trace_start(kind, start)) return 1;
+    remember_initial(mem, kind == IMAGE_STANDARD ? MEMORYSIZE : kind == IMAGE_PACKED ? PACKED_WORDS : words * 2);
+    start_clock();
+    VmState state = *start;
+    int status = 0;
+    if (snapshotStep != UINT64_MAX || snapshotPc != UINT32_MAX)
+        status = run_to_snapshot(kind, mem, words, &state);
+    if (!status) {
+        if (kind == IMAGE_PACKED) status = run_packed(mem, &state);
+        else if (kind == IMAGE_EXTENDED) status = run_extended(mem, words, &state);
+        else status = run_standard(mem, &state);
+    }
+    if (traceRing) trace_finish(status);
+    if (snapshotStep != UINT64_MAX || snapshotPc != UINT32_MAX)
+        fprintf(stderr, status ? "Snapshot não gravado: o limite interrompeu a execução antes do ponto pedido\n"
+                               : "Snapshot não gravado: o programa terminou antes do ponto pedido\n");
+    return status;
+}
+
+int run_snapshot(int fd, size_t size) {
+    uint8_t *data = malloc(size);
+    if (read(fd, data, size) != (ssize_t)size || size < SNAPSHOT_FIXEDSIZE) {
+        printf("Snapshot corrompido\n");
+        free(data);
+        return 1;
+    }
+
+    ImageKind kind = data[HEADERSIZE];
+    VmState state;
+    state.ac = read_u16(data + HEADERSIZE + 2);
+    state.pc = read_u32(data + HEADERSIZE + 4);
+    state.steps = read_u32(data + HEADERSIZE + 8) | ((uint64_t)read_u32(data + HEADERSIZE + 12) << 32);
+    uint32_t memorySize = read_u32(data + HEADERSIZE + 16);
+    uint32_t runCount = read_u32(data + HEADERSIZE + 20);
+
+    uint32_t expected = kind == IMAGE_STANDARD ? MEMORYSIZE : kind == IMAGE_PACKED ? PACKED_WORDS : memorySize;
+    if (kind > IMAGE_EXTENDED || memorySize != expected || memorySize > EXTENDED_MAX_WORDS * 2 || memorySize < 8) {
+        printf("Snapshot corrompido\n");
+        free(data);
+        return 1;
+    }
+
+    uint8_t *memory = calloc(memorySize, 1);
+    size_t pos = SNAPSHOT_FIXEDSIZE;
+    for (uint32_t i = 0; i < runCount; i++) {
+        if (pos + 8 > size) break;
+        uint32_t offset = read_u32(data + pos);
+        uint32_t length = read_u32(data + pos + 4);
+        pos += 8;
+        if ((uint64_t)offset + length > memorySize || pos + length > size) {
+            printf("Snapshot corrompido\n");
+            free(memory);
+            free(data);
+            return 1;
+        }
+        memcpy(memory + offset, data + pos, length);
+        pos += length;
+    }
+    free(data);
+
+    uint32_t words = kind == IMAGE_STANDARD ? STANDARD_WORDS : kind == IMAGE_PACKED ? PACKED_WORDS : memorySize / 2;
+    int status = run_image(kind, memory, words, &state);
+    free(memory);
+    return status;
+}
+
+int run_bundle(int fd, size_t size, uint32_t index) {
+    const uint8_t *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("Falha ao mapear pacote");
+        return 1;
+    }
+
+    uint32_t count = size >= HEADERSIZE + 4 ? read_u32(base + HEADERSIZE) : 0;
+    const uint8_t *offsets = base + HEADERSIZE + 4;
+    if (index >= count || HEADERSIZE + 4 + ((size_t)count + 1) * 4 > size) {
+        printf("Imagem %u inexistente no pacote\n", index);
+        munmap((void *)base, size);
+        return 1;
+    }
+
+    uint32_t start = read_u32(offsets + index * 4);
+    uint32_t end = read_u32(offsets + (index + 1) * 4);
+    if (start > end || end > size || end - start < HEADERSIZE + 2) {
+        printf("Pacote corrompido\n");
+        munmap((void *)base, size);
+        return 1;
+    }
+
+    const uint8_t *image = base + start;
+    const uint8_t *limit = base + end;
+    const uint8_t standardHeader[] = HEADER_STANDARD;
+    const uint8_t packedHeader[] = HEADER_PACKED;
+    bool packed = memcmp(image, packedHeader, HEADERSIZE) == 0;
+    if (!packed && memcmp(image, standardHeader, HEADERSIZE) != 0) {
+        printf("Cabeçalho fora do padrão\n");
+        munmap((void *)base, size);
+        return 1;
+    }
+
+    uint8_t memory[MEMORYSIZE] = {0};
+    uint8_t *body = packed ? memory : memory + HEADERSIZE;
+    size_t bodySize = packed ? PACKED_WORDS : STANDARD_IMAGESIZE - HEADERSIZE;
+
+    uint32_t runCount = read_u16(image + HEADERSIZE);
+    const uint8_t *p = image + HEADERSIZE + 2;
+    for (uint32_t i = 0; i < runCount; i++) {
+        if (p + 4 > limit) break;
+        uint32_t offset = read_u16(p);
+        uint32_t length = read_u16(p + 2);
+        p += 4;
+        if (offset + length > bodySize || p + length > limit) {
+            printf("Pacote corrompido\n");
+            munmap((void *)base, size);
+            return 1;
+        }
+        memcpy(body + offset, p, length);
+        p += length;
+    }
+    munmap((void *)base, size);
+
+    if (packed) return run_image(IMAGE_PACKED, memory, PACKED_WORDS, &INITIAL_STATE);
+    return run_image(IMAGE_STANDARD, memory, STANDARD_WORDS, &INITIAL_STATE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = "programa.mem";
+    const char *indexArg = NULL;
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc) {
+            maxSteps = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--timeout-ms") == 0 && i + 1 < argc) {
+            timeoutNs = strtoull(argv[++i], NULL, 10) * 1000000ull;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsEnabled = true;
+        } else if (strcmp(argv[i], "--debug") == 0) {
+            debugMode = true;
+        } else if (strcmp(argv[i], "--debug-script") == 0 && i + 1 < argc) {
+            debugMode = true;
+            debugScript = argv[++i];
+        } else if (strcmp(argv[i], "--snapshot-step") == 0 && i + 1 < argc) {
+            snapshotStep = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--snapshot-pc") == 0 && i + 1 < argc) {
+            snapshotPc = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            unsigned long entries = strtoul(argv[++i], NULL, 10);
+            if (entries > TRACE_MAX_ENTRIES) entries = TRACE_MAX_ENTRIES;
+            traceEntries = 0;
+            if (entries) {
+                traceEntries = 1;
+                while (traceEntries < entries) traceEntries <<= 1;
+            }
+        } else if (strcmp(argv[i], "--trace-out") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--trace-dump") == 0) {
+            traceDump = true;
+        } else if (strcmp(argv[i], "--patch") == 0 && i + 1 < argc) {
+            unsigned word, value;
+            if (patchCount >= MAX_PATCHES || sscanf(argv[++i], "%i=%i", &word, &value) != 2) {
+                printf("Patch inválido: %s (use palavra=valor)\n", argv[i]);
+                return 1;
+            }
+            patchWords[patchCount] = word;
+            patchValues[patchCount] = (uint16_t)value;
+            patchCount++;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "full") == 0) outputMode = OUTPUT_FULL;
+            else if (strcmp(mode, "regs") == 0) outputMode = OUTPUT_REGS;
+            else if (strcmp(mode, "diff") == 0) outputMode = OUTPUT_DIFF;
+            else if (strcmp(mode, "raw") == 0) outputMode = OUTPUT_RAW;
+            else if (strcmp(mode, "json") == 0) outputMode = OUTPUT_JSON;
+            else {
+                printf("Modo de saída desconhecido: %s\n", mode);
+                return 1;
+            }
+        } else if (positional == 0) {
+            path = argv[i];
+            positional++;
+        } else if (positional == 1) {
+            indexArg = argv[i];
+            positional++;
+        }
+    }
+
+    stat_begin(&loadStage, "load");
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Falha ao abrir .mem");
+        return 1;
+    }
+
+    struct stat st;
+    uint8_t fileHeader[HEADERSIZE] = {0};
+    if (fstat(fd, &st) != 0 || read(fd, fileHeader, HEADERSIZE) != HEADERSIZE) {
+        printf("Cabeçalho fora do padrão\n");
+        close(fd);
+        return 1;
+    }
+
+    const uint8_t bundleHeader[] = HEADER_BUNDLE;
+    if (memcmp(fileHeader, bundleHeader, HEADERSIZE) == 0) {
+        uint32_t index = indexArg ? (uint32_t)strtoul(indexArg, NULL, 10) : 0;
+        return run_bundle(fd, st.st_size, index);
+    }
+
+    const uint8_t snapshotHeader[] = HEADER_SNAPSHOT;
+    if (memcmp(fileHeader, snapshotHeader, HEADERSIZE) == 0) {
+        lseek(fd, 0, SEEK_SET);
+        int status = run_snapshot(fd, st.st_size);
+        close(fd);
+        return status;
+    }
+
+    const uint8_t extendedHeader[] = HEADER_EXTENDED;
+    if (memcmp(fileHeader, extendedHeader, HEADERSIZE) == 0) {
+        uint8_t sizeField[4];
+        uint32_t words = read(fd, sizeField, 4) == 4 ? read_u32(sizeField) : 0;
+        if (words < 4 || words > EXTENDED_MAX_WORDS) {
+            printf("Tamanho de memória inválido\n");
+            close(fd);
+            return 1;
+        }
+        uint8_t *extended = calloc(words, 2);
+        read(fd, extended, words * 2);
+        close(fd);
+        int status = run_image(IMAGE_EXTENDED, extended, words, &INITIAL_STATE);
+        free(extended);
+        return status;
+    }
+
+    uint8_t memory[MEMORYSIZE] = {0};
+    const uint8_t expectedHeader[] = HEADER_STANDARD;
+    const uint8_t packedHeader[] = HEADER_PACKED;
+    if (memcmp(fileHeader, packedHeader, HEADERSIZE) == 0) {
+        read(fd, memory, PACKED_WORDS);
+        close(fd);
+        return run_image(IMAGE_PACKED, memory, PACKED_WORDS, &INITIAL_STATE);
+    }
+    if (memcmp(fileHeader, expectedHeader, HEADERSIZE) != 0) {
+        printf("Cabeçalho fora do padrão\n");
+        close(fd);
+        return 1;
+    }
+
+    read(fd, memory + HEADERSIZE, MEMORYSIZE - HEADERSIZE);
+    close(fd);
+    return run_image(IMAGE_STANDARD, memory, STANDARD_WORDS, &INITIAL_STATE);
+}
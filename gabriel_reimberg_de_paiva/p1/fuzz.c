@@ -0,0 +1,670 @@
+/*
+ * Fuzz diferencial. O laço de produção do executor (run_image) é o oráculo;
+ * cada imagem roda também pelos caminhos alternativos, que precisam chegar
+ * à mesma memória, AC, PC e código de saída:
+ *   rastro     o mesmo laço com --trace ligado
+ *   depurador  o laço do --debug, comando "c"
+ *   snapshot   grava o estado na instrução k e retoma do arquivo
+ * O executor é incluído inteiro para que o libFuzzer meça a cobertura dos
+ * laços. Com --lpn, gera programas .lpn e compara o pipeline (formatos
+ * padrão, compacto e estendido, cache do compilador com uma edição do
+ * programa e ligador) chamando as ferramentas, como o benchmark.
+ *
+ * Sozinho:    make fuzz, ou ./fuzzer [--runs N] [--seed S] [--lpn] [--replay entrada]
+ * libFuzzer:  clang -g -O1 -fsanitize=fuzzer,address -DFUZZ_LIBFUZZER -o fuzzer_lf fuzz.c
+ */
+#define main executor_main
+#include "executor.c"
+#undef main
+
+#include <sys/wait.h>
+
+#define FUZZ_DIR "fuzz"
+#define FUZZ_MAX_STEPS 20000
+#define FUZZ_INPUT_HEADER 3
+#define FUZZ_MAX_WORDS (16 + 255 * 4)
+#define FUZZ_MAX_INPUT (FUZZ_INPUT_HEADER + FUZZ_MAX_WORDS * 2)
+
+/*
+ * Entrada: byte 0 escolhe o formato, byte 1 a instrução do snapshot
+ * (5 bits de valor e 3 de escala, até ~4000) e byte 2 o tamanho da memória estendida (16 + 4n palavras); o
+ * restante preenche a memória a partir da palavra 0.
+ */
+typedef struct {
+    ImageKind kind;
+    uint32_t words;
+    uint64_t snapshotAt;
+    uint8_t mem[FUZZ_MAX_WORDS * 2];
+    size_t size;
+} FuzzImage;
+
+typedef struct {
+    bool ran;
+    int status;
+    uint8_t *raw;
+    size_t rawSize;
+} Outcome;
+
+typedef struct {
+    const char *name;
+    void (*run)(const FuzzImage *image, const Outcome *oracle, Outcome *out);
+} Engine;
+
+FILE *savedStdout, *savedStderr, *nullOutput;
+char *captureData;
+size_t captureSize;
+
+void decode_input(const uint8_t *data, size_t size, FuzzImage *image) {
+    uint8_t header[FUZZ_INPUT_HEADER] = {0};
+    memcpy(header, data, size < FUZZ_INPUT_HEADER ? size : FUZZ_INPUT_HEADER);
+    image->kind = (ImageKind)(header[0] % 3);
+    image->snapshotAt = (uint64_t)(header[1] & 0x1F) << (header[1] >> 5);
+    memset(image->mem, 0, sizeof(image->mem));
+
+    size_t offset = 0;
+    if (image->kind == IMAGE_STANDARD) {
+        const uint8_t standardHeader[] = HEADER_STANDARD;
+        memcpy(image->mem, standardHeader, HEADERSIZE);
+        image->words = STANDARD_WORDS;
+        image->size = MEMORYSIZE;
+        offset = HEADERSIZE;
+    } else if (image->kind == IMAGE_PACKED) {
+        image->words = PACKED_WORDS;
+        image->size = PACKED_WORDS;
+    } else {
+        image->words = 16 + header[2] * 4;
+        image->size = image->words * 2;
+    }
+    if (size > FUZZ_INPUT_HEADER) {
+        size_t body = size - FUZZ_INPUT_HEADER;
+        if (body > image->size - offset) body = image->size - offset;
+        memcpy(image->mem + offset, data + FUZZ_INPUT_HEADER, body);
+    }
+}
+
+void reset_executor(void) {
+    outputMode = OUTPUT_RAW;
+    widePc = false;
+    maxSteps = FUZZ_MAX_STEPS;
+    timeoutNs = 0;
+    snapshotStep = UINT64_MAX;
+    snapshotPc = UINT32_MAX;
+    snapshotPath = FUZZ_DIR "/estado.snap";
+    patchCount = 0;
+    debugMode = false;
+    debugScript = NULL;
+    traceEntries = 0;
+    traceDump = false;
+    tracePath = FUZZ_DIR "/rastro.ntr";
+}
+
+/* O executor escreve em stdout/stderr; durante a execução eles viram memória e /dev/null */
+void capture_begin(void) {
+    fflush(stdout);
+    fflush(stderr);
+    savedStdout = stdout;
+    savedStderr = stderr;
+    stdout = open_memstream(&captureData, &captureSize);
+    stderr = nullOutput;
+}
+
+/* A saída raw (memória, AC, PC) é sempre o fim do que foi escrito */
+void capture_end(const FuzzImage *image, int status, Outcome *out) {
+    fclose(stdout);
+    stdout = savedStdout;
+    stderr = savedStderr;
+    size_t rawSize = image->size + 1 + (image->kind == IMAGE_EXTENDED ? 2 : 1);
+    out->ran = true;
+    out->status = status;
+    out->rawSize = 0;
+    free(out->raw);
+    out->raw = NULL;
+    if (captureSize >= rawSize) {
+        out->raw = malloc(rawSize);
+        memcpy(out->raw, captureData + captureSize - rawSize, rawSize);
+        out->rawSize = rawSize;
+    }
+    free(captureData);
+}
+
+void run_fresh(const FuzzImage *image, Outcome *out) {
+    uint8_t mem[FUZZ_MAX_WORDS * 2];
+    memcpy(mem, image->mem, image->size);
+    capture_begin();
+    int status = run_image(image->kind, mem, image->words, &INITIAL_STATE);
+    capture_end(image, status, out);
+}
+
+void engine_production(const FuzzImage *image, const Outcome *oracle, Outcome *out) {
+    (void)oracle;
+    reset_executor();
+    run_fresh(image, out);
+}
+
+void engine_trace(const FuzzImage *image, const Outcome *oracle, Outcome *out) {
+    (void)oracle;
+    reset_executor();
+    traceEntries = 64;
+    run_fresh(image, out);
+}
+
+/* O depurador só imprime o estado final ao chegar ao HLT */
+void engine_debug(const FuzzImage *image, const Outcome *oracle, Outcome *out) {
+    if (oracle->status != 0) return;
+    reset_executor();
+    debugMode = true;
+    debugScript = FUZZ_DIR "/roteiro.txt";
+    run_fresh(image, out);
+}
+
+void engine_snapshot(const FuzzImage *image, const Outcome *oracle, Outcome *out) {
+    if (oracle->status != 0) return;
+    reset_executor();
+    snapshotStep = image->snapshotAt;
+    Outcome first = {0};
+    run_fresh(image, &first);
+    free(first.raw);
+    if (snapshotStep != UINT64_MAX) return;
+
+    int fd = open(snapshotPath, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        return;
+    }
+    reset_executor();
+    capture_begin();
+    int status = run_snapshot(fd, st.st_size);
+    capture_end(image, status, out);
+    close(fd);
+}
+
+const Engine ENGINES[] = {
+    { "rastro",    engine_trace    },
+    { "depurador", engine_debug    },
+    { "snapshot",  engine_snapshot },
+};
+#define ENGINE_COUNT (sizeof(ENGINES) / sizeof(ENGINES[0]))
+int engineComparisons[ENGINE_COUNT];
+
+bool same_outcome(const Outcome *a, const Outcome *b) {
+    return a->status == b->status && a->rawSize == b->rawSize &&
+           (a->rawSize == 0 || memcmp(a->raw, b->raw, a->rawSize) == 0);
+}
+
+void describe_mismatch(const FuzzImage *image, const char *engine, const Outcome *oracle, const Outcome *out) {
+    const char *kinds[] = { "padrao", "compacto", "estendido" };
+    fprintf(stderr, "Divergência em %s (formato %s): status %d x %d", engine, kinds[image->kind],
+            oracle->status, out->status);
+    if (oracle->rawSize != out->rawSize) {
+        fprintf(stderr, ", saída com %zu x %zu bytes\n", oracle->rawSize, out->rawSize);
+        return;
+    }
+    for (size_t i = 0; i < oracle->rawSize; i++) {
+        if (oracle->raw[i] == out->raw[i]) continue;
+        if (i < image->size) fprintf(stderr, ", memória[0x%zX] 0x%02X x 0x%02X", i, oracle->raw[i], out->raw[i]);
+        else fprintf(stderr, ", registrador +%zu 0x%02X x 0x%02X", i - image->size, oracle->raw[i], out->raw[i]);
+        break;
+    }
+    fprintf(stderr, "\n");
+}
+
+/* Devolve o índice do primeiro caminho que diverge do oráculo, ou -1 */
+int fuzz_one(const uint8_t *data, size_t size, bool verbose) {
+    static FuzzImage image;
+    decode_input(data, size, &image);
+    Outcome oracle = {0};
+    engine_production(&image, NULL, &oracle);
+
+    int failed = -1;
+    for (size_t e = 0; e < ENGINE_COUNT && failed < 0; e++) {
+        Outcome out = {0};
+        ENGINES[e].run(&image, &oracle, &out);
+        if (out.ran && verbose) engineComparisons[e]++;
+        if (out.ran && !same_outcome(&oracle, &out)) {
+            failed = (int)e;
+            if (verbose) describe_mismatch(&image, ENGINES[e].name, &oracle, &out);
+        }
+        free(out.raw);
+    }
+    free(oracle.raw);
+    return failed;
+}
+
+bool fuzz_setup(void) {
+    mkdir(FUZZ_DIR, 0755);
+    nullOutput = fopen("/dev/null", "w");
+    FILE *script = fopen(FUZZ_DIR "/roteiro.txt", "w");
+    if (!nullOutput || !script) {
+        perror("Erro ao preparar " FUZZ_DIR);
+        return false;
+    }
+    fprintf(script, "c\n");
+    fclose(script);
+    return true;
+}
+
+#ifdef FUZZ_LIBFUZZER
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void)argc;
+    (void)argv;
+    if (!fuzz_setup()) abort();
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (fuzz_one(data, size, true) >= 0) abort();
+    return 0;
+}
+
+#else
+
+uint64_t rngState = 1;
+
+uint32_t next_random(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (uint32_t)(rngState >> 16);
+}
+
+const uint8_t FUZZ_OPCODES[] = {
+    OPCODE_NOP, OPCODE_STA, OPCODE_LDA, OPCODE_ADD, OPCODE_SUB, OPCODE_OR,
+    OPCODE_AND, OPCODE_NOT, OPCODE_JMP, OPCODE_JMN, OPCODE_JMZ, OPCODE_HLT
+};
+
+/* Código com opcodes válidos e operandos dentro da memória seguido de dados aleatórios */
+size_t generate_input(uint8_t *data) {
+    for (int i = 0; i < FUZZ_INPUT_HEADER; i++) data[i] = (uint8_t)next_random();
+    ImageKind kind = (ImageKind)(data[0] % 3);
+    int bytesPerWord = kind == IMAGE_PACKED ? 1 : 2;
+    uint32_t words = kind == IMAGE_STANDARD ? (MEMORYSIZE - HEADERSIZE) / 2 : kind == IMAGE_PACKED ? PACKED_WORDS : 16 + data[2] * 4u;
+    uint32_t operandRange = kind == IMAGE_EXTENDED ? words : 256;
+    uint32_t codeWords = next_random() % words;
+
+    uint8_t *body = data + FUZZ_INPUT_HEADER;
+    for (uint32_t w = 0; w < words; w++) {
+        uint32_t value;
+        if (w < codeWords && w % 2 == 0) value = FUZZ_OPCODES[next_random() % sizeof(FUZZ_OPCODES)];
+        else if (w < codeWords) value = next_random() % operandRange;
+        else value = next_random() & 0xFF;
+        body[w * bytesPerWord] = (uint8_t)value;
+        if (bytesPerWord == 2) body[w * 2 + 1] = kind == IMAGE_EXTENDED ? (uint8_t)(value >> 8) : 0;
+    }
+    return FUZZ_INPUT_HEADER + words * bytesPerWord;
+}
+
+/* Zera bytes e corta o fim enquanto o mesmo caminho continuar divergindo */
+size_t minimize_input(uint8_t *data, size_t size, int engine) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = FUZZ_INPUT_HEADER; i < size; i++) {
+            if (data[i] == 0) continue;
+            uint8_t saved = data[i];
+            data[i] = 0;
+            if (fuzz_one(data, size, false) == engine) changed = true;
+            else data[i] = saved;
+        }
+        while (size > FUZZ_INPUT_HEADER && data[size - 1] == 0) size--;
+    }
+    return size;
+}
+
+/* Grava a entrada (para --replay) e a imagem equivalente, que roda direto no executor */
+void save_failure(const uint8_t *data, size_t size, int index) {
+    char path[128];
+    snprintf(path, sizeof(path), FUZZ_DIR "/falha_%d.in", index);
+    FILE *out = fopen(path, "wb");
+    if (out) {
+        fwrite(data, 1, size, out);
+        fclose(out);
+    }
+
+    static FuzzImage image;
+    decode_input(data, size, &image);
+    snprintf(path, sizeof(path), FUZZ_DIR "/falha_%d.mem", index);
+    out = fopen(path, "wb");
+    if (!out) return;
+    if (image.kind == IMAGE_STANDARD) {
+        fwrite(image.mem, 1, image.size, out);
+    } else if (image.kind == IMAGE_PACKED) {
+        const uint8_t header[] = HEADER_PACKED;
+        fwrite(header, 1, HEADERSIZE, out);
+        fwrite(image.mem, 1, image.size, out);
+    } else {
+        const uint8_t header[] = HEADER_EXTENDED;
+        fwrite(header, 1, HEADERSIZE, out);
+        write_u32(out, image.words);
+        fwrite(image.mem, 1, image.size, out);
+    }
+    fclose(out);
+    printf("Caso mínimo em %s/falha_%d.in e %s (snapshot na instrução %llu)\n", FUZZ_DIR, index, path,
+           (unsigned long long)image.snapshotAt);
+}
+
+int fuzz_images(int runs) {
+    static uint8_t data[FUZZ_MAX_INPUT];
+    int failures = 0;
+    for (int r = 0; r < runs; r++) {
+        size_t size = generate_input(data);
+        int engine = fuzz_one(data, size, true);
+        if (engine < 0) continue;
+        size = minimize_input(data, size, engine);
+        save_failure(data, size, failures++);
+    }
+    printf("%d imagens, %d divergências; comparações:", runs, failures);
+    for (size_t e = 0; e < ENGINE_COUNT; e++) printf(" %s %d", ENGINES[e].name, engineComparisons[e]);
+    printf("\n");
+    return failures ? 1 : 0;
+}
+
+int replay_input(const char *path) {
+    static uint8_t data[FUZZ_MAX_INPUT];
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    size_t size = fread(data, 1, sizeof(data), in);
+    fclose(in);
+    int engine = fuzz_one(data, size, true);
+    printf("%s\n", engine < 0 ? "Sem divergência" : "Divergência reproduzida");
+    return engine < 0 ? 0 : 1;
+}
+
+/*
+ * Modo --lpn: programa gerado -> compilador -> assembler nos três formatos,
+ * pelo cache e pelo ligador. Todo programa gerado compila e termina dentro
+ * dos ciclos estimados pelo --report; qualquer etapa que falhe é divergência.
+ * O oráculo é a imagem padrão quando o relatório diz que ela cabe, senão a
+ * estendida.
+ */
+#define LPN_OPS "+-*/%^"
+
+int run_quiet(char *const argv[], const char *stdoutPath) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int out = open(stdoutPath ? stdoutPath : "/dev/null", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(out, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+bool same_file(const char *a, const char *b) {
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    bool same = fa && fb;
+    while (same) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        if (ca != cb) same = false;
+        if (ca == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+/* Executa a imagem com saída json e lê status e RES */
+bool execute_image(const char *mem, int maxSteps, int *status, int *res) {
+    char steps[32];
+    snprintf(steps, sizeof(steps), "%d", maxSteps);
+    char *execute[] = { "./executor", "--max-steps", steps, "--output", "json", (char *)mem, NULL };
+    run_quiet(execute, FUZZ_DIR "/saida.json");
+    FILE *in = fopen(FUZZ_DIR "/saida.json", "r");
+    if (!in) return false;
+    bool ok = fscanf(in, "{\"status\":%d,\"steps\":%*u,\"ac\":%*u,\"pc\":%*u,\"res\":%d", status, res) == 2;
+    fclose(in);
+    return ok;
+}
+
+/* Lê a linha "Total:" do --report: instruções, palavras de dados e ciclos no pior caso */
+bool read_report(const char *path, int *instructions, int *data, int *cycles) {
+    FILE *in = fopen(path, "r");
+    if (!in) return false;
+    char line[256];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), in))
+        found = sscanf(line, "Total: %d instruções, %d palavras de dados, %d ciclos", instructions, data, cycles) == 3;
+    fclose(in);
+    return found;
+}
+
+void write_lpn(const char *path, char lines[][96], int count) {
+    FILE *out = fopen(path, "w");
+    if (!out) return;
+    fprintf(out, "PROGRAMA \"Fuzz\":\nINICIO\n");
+    for (int i = 0; i < count; i++) fprintf(out, "%s\n", lines[i]);
+    fprintf(out, "FIM\n");
+    fclose(out);
+}
+
+/* Variante com uma linha alterada (literal ou operador), para o cache receber um programa editado */
+void edit_lpn(char lines[][96], int count, uint32_t edit, char variant[][96]) {
+    memcpy(variant, lines, count * sizeof(lines[0]));
+    int i = edit % count;
+    unsigned value = (edit >> 8) % 256;
+    char target[16], left[16], right[16], op;
+    if (sscanf(lines[i], "%15s = %15s %c %15s", target, left, &op, right) == 4) {
+        if (right[0] >= '0' && right[0] <= '9') snprintf(right, sizeof(right), "%u", value);
+        snprintf(variant[i], 96, "%s = %s %c %s", target, left, LPN_OPS[(edit >> 16) % 6], right);
+    } else {
+        snprintf(variant[i], 96, "%s = %u", target, value);
+    }
+}
+
+const char *lpn_failure(const char *stage, int res, bool verbose) {
+    if (verbose && res >= 0) fprintf(stderr, "Divergência em %s (RES esperado 0x%02X)\n", stage, res);
+    else if (verbose) fprintf(stderr, "Divergência em %s\n", stage);
+    return stage;
+}
+
+/* Devolve a etapa que divergiu ou NULL; fits recebe se o programa cabe no formato padrão */
+const char *check_lpn(char lines[][96], int count, uint32_t edit, bool *fits, bool verbose) {
+    write_lpn(FUZZ_DIR "/caso.lpn", lines, count);
+    char *compile[] = { "./compilador", "--report", FUZZ_DIR "/caso.lpn", NULL };
+    int instructions, data, cycles;
+    if (run_quiet(compile, FUZZ_DIR "/relatorio.txt") != 0 ||
+        !read_report(FUZZ_DIR "/relatorio.txt", &instructions, &data, &cycles))
+        return lpn_failure("compilador", -1, verbose);
+    bool standardFits = instructions <= STANDARD_CODE_INSTRUCTIONS && data <= STANDARD_DATA_WORDS;
+    if (fits) *fits = standardFits;
+
+    char *standard[] = { "./assembler", FUZZ_DIR "/caso.asm", FUZZ_DIR "/caso.mem", NULL };
+    char *packed[] = { "./assembler", "--packed", FUZZ_DIR "/caso.asm", FUZZ_DIR "/caso_p.mem", NULL };
+    char *extended[] = { "./assembler", "--extended", FUZZ_DIR "/caso.asm", FUZZ_DIR "/caso_x.mem", NULL };
+    char *const *layouts[] = { standard, packed, extended };
+    const char *memPaths[] = { standard[2], packed[3], extended[3] };
+    const char *names[] = { "padrao", "compacto", "estendido" };
+
+    /* o formato padrão recusa exatamente os programas que o relatório diz não caberem */
+    bool standardBuilt = run_quiet(standard, NULL) == 0;
+    if (standardBuilt != standardFits) return lpn_failure("padrao", -1, verbose);
+    int oracle = standardFits ? 0 : 2;
+    int oracleStatus, oracleRes;
+    if ((oracle != 0 && run_quiet(layouts[oracle], NULL) != 0) ||
+        !execute_image(memPaths[oracle], cycles, &oracleStatus, &oracleRes) || oracleStatus != 0)
+        return lpn_failure(names[oracle], -1, verbose);
+
+    for (int l = 0; l < 3; l++) {
+        if (l == oracle || (l == 0 && !standardFits)) continue;
+        bool built = run_quiet(layouts[l], NULL) == 0;
+        /* fora do formato padrão o compacto pode legitimamente não ter espaço */
+        if (!built && l == 1 && !standardFits) continue;
+        int status, res;
+        if (!built || !execute_image(memPaths[l], cycles, &status, &res) || status != oracleStatus || res != oracleRes)
+            return lpn_failure(names[l], oracleRes, verbose);
+    }
+
+    /* o cache vê o programa e depois uma edição dele, e precisa gerar o mesmo .asm que sem cache */
+    char variant[16][96];
+    edit_lpn(lines, count, edit, variant);
+    write_lpn(FUZZ_DIR "/caso_c.lpn", lines, count);
+    write_lpn(FUZZ_DIR "/variante.lpn", variant, count);
+    write_lpn(FUZZ_DIR "/variante_c.lpn", variant, count);
+    char *cached[] = { "./compilador", "--cache", FUZZ_DIR "/cache", FUZZ_DIR "/caso_c.lpn", NULL };
+    char *edited[] = { "./compilador", FUZZ_DIR "/variante.lpn", NULL };
+    char *editedCached[] = { "./compilador", "--cache", FUZZ_DIR "/cache", FUZZ_DIR "/variante_c.lpn", NULL };
+    if (run_quiet(cached, NULL) != 0 || !same_file(FUZZ_DIR "/caso.asm", FUZZ_DIR "/caso_c.asm") ||
+        run_quiet(edited, NULL) != 0 || run_quiet(editedCached, NULL) != 0 ||
+        !same_file(FUZZ_DIR "/variante.asm", FUZZ_DIR "/variante_c.asm"))
+        return lpn_failure("cache", oracleRes, verbose);
+
+    /* o ligador usa o formato padrão e também precisa recusar o que não cabe nele */
+    char *object[] = { "./assembler", "--object", FUZZ_DIR "/caso.asm", FUZZ_DIR "/caso.obj", NULL };
+    char *link[] = { "./ligador", FUZZ_DIR "/caso_l.mem", FUZZ_DIR "/caso.obj", NULL };
+    bool linked = run_quiet(object, NULL) == 0 && run_quiet(link, NULL) == 0;
+    if (linked != standardFits || (linked && !same_file(FUZZ_DIR "/caso.mem", FUZZ_DIR "/caso_l.mem")))
+        return lpn_failure("ligador", oracleRes, verbose);
+    return NULL;
+}
+
+int generate_lpn(char lines[][96], int max) {
+    int vars = 2 + next_random() % 3;
+    int count = 0;
+    for (int v = 0; v < vars; v++)
+        snprintf(lines[count++], 96, "v%d = %u", v, next_random() % 256);
+    int statements = next_random() % 4;
+    for (int s = 0; s <= statements && count < max; s++) {
+        const char *target = s == statements ? "RES" : NULL;
+        char left[16], right[16];
+        snprintf(left, sizeof(left), "v%u", next_random() % vars);
+        if (next_random() % 3 == 0) snprintf(right, sizeof(right), "%u", next_random() % 256);
+        else snprintf(right, sizeof(right), "v%u", next_random() % vars);
+        char op = LPN_OPS[next_random() % 6];
+        if (target) snprintf(lines[count++], 96, "RES = %s %c %s", left, op, right);
+        else snprintf(lines[count++], 96, "v%u = %s %c %s", next_random() % vars, left, op, right);
+    }
+    return count;
+}
+
+/* Casos fixos com RES conhecido, conferidos nos três formatos antes dos programas aleatórios */
+typedef struct {
+    const char *source;
+    int res;
+} LpnRegression;
+
+const LpnRegression LPN_REGRESSIONS[] = {
+    { "a = 200;b = 2;RES = a / b",   0x64 },
+    { "a = 200;b = 7;RES = a % b",   0x04 },
+    { "a = 255;b = 1;RES = a / b",   0xFF },
+    { "a = 255;b = 200;RES = a % b", 0x37 },
+    { "a = 128;b = 128;RES = a / b", 0x01 },
+    { "a = 100;b = 200;RES = a / b", 0x00 },
+    { "a = 100;b = 200;RES = a % b", 0x64 },
+    { "a = 9;b = 0;RES = a % b",     0x09 },
+    { "a = 200;RES = a / 2",         0x64 },
+    { "RES = 200 % 7",               0x04 },
+    { "RES = 9 / 0",                 0x00 },
+};
+
+int check_regressions(void) {
+    const char *lpn = FUZZ_DIR "/regressao.lpn";
+    char *compile[] = { "./compilador", (char *)lpn, NULL };
+    char *standard[] = { "./assembler", FUZZ_DIR "/regressao.asm", FUZZ_DIR "/regressao.mem", NULL };
+    char *packed[] = { "./assembler", "--packed", FUZZ_DIR "/regressao.asm", FUZZ_DIR "/regressao_p.mem", NULL };
+    char *extended[] = { "./assembler", "--extended", FUZZ_DIR "/regressao.asm", FUZZ_DIR "/regressao_x.mem", NULL };
+    char *const *layouts[] = { standard, packed, extended };
+    const char *memPaths[] = { standard[2], packed[3], extended[3] };
+    const char *names[] = { "padrao", "compacto", "estendido" };
+
+    int failures = 0;
+    size_t count = sizeof(LPN_REGRESSIONS) / sizeof(LPN_REGRESSIONS[0]);
+    for (size_t c = 0; c < count; c++) {
+        char lines[16][96];
+        int lineCount = 0;
+        char source[256];
+        snprintf(source, sizeof(source), "%s", LPN_REGRESSIONS[c].source);
+        for (char *line = strtok(source, ";"); line && lineCount < 16; line = strtok(NULL, ";"))
+            snprintf(lines[lineCount++], 96, "%s", line);
+        write_lpn(lpn, lines, lineCount);
+
+        bool compiled = run_quiet(compile, NULL) == 0;
+        for (int l = 0; l < 3; l++) {
+            int status = -1, res = -1;
+            if (compiled && run_quiet(layouts[l], NULL) == 0 &&
+                execute_image(memPaths[l], FUZZ_MAX_STEPS * 10, &status, &res) &&
+                status == 0 && res == LPN_REGRESSIONS[c].res)
+                continue;
+            fprintf(stderr, "Regressão \"%s\" (formato %s): RES 0x%02X, esperado 0x%02X\n",
+                    LPN_REGRESSIONS[c].source, names[l], res & 0xFF, LPN_REGRESSIONS[c].res);
+            failures++;
+        }
+    }
+    printf("%zu casos de regressão, %d falhas\n", count, failures);
+    return failures;
+}
+
+int fuzz_lpn(int runs) {
+    char lines[16][96];
+    int failures = check_regressions(), large = 0;
+    for (int r = 0; r < runs; r++) {
+        int count = generate_lpn(lines, 16);
+        uint32_t edit = next_random();
+        bool fits = true;
+        const char *failure = check_lpn(lines, count, edit, &fits, true);
+        if (!fits) large++;
+        if (!failure) continue;
+
+        /* remove linhas (exceto a de RES) enquanto a mesma etapa continuar divergindo */
+        for (int i = count - 2; i >= 0; i--) {
+            char saved[96];
+            memcpy(saved, lines[i], sizeof(saved));
+            memmove(lines[i], lines[i + 1], (count - i - 1) * sizeof(lines[0]));
+            const char *again = check_lpn(lines, count - 1, edit, NULL, false);
+            if (again && strcmp(again, failure) == 0) {
+                count--;
+                continue;
+            }
+            memmove(lines[i + 1], lines[i], (count - i - 1) * sizeof(lines[0]));
+            memcpy(lines[i], saved, sizeof(saved));
+        }
+        char path[128];
+        snprintf(path, sizeof(path), FUZZ_DIR "/falha_%d.lpn", failures);
+        write_lpn(path, lines, count);
+        printf("Caso mínimo em %s\n", path);
+        if (strcmp(failure, "cache") == 0) {
+            char variant[16][96];
+            edit_lpn(lines, count, edit, variant);
+            snprintf(path, sizeof(path), FUZZ_DIR "/falha_%d_variante.lpn", failures);
+            write_lpn(path, variant, count);
+            printf("Edição compilada com o cache em %s\n", path);
+        }
+        failures++;
+    }
+    printf("%d programas (%d só nos formatos compacto e estendido), %d divergências\n", runs, large, failures);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 1000;
+    bool lpn = false;
+    const char *replay = NULL;
+    rngState = (uint64_t)time(NULL) | 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            rngState = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "--lpn") == 0) {
+            lpn = true;
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay = argv[++i];
+        } else {
+            printf("Uso: %s [--runs N] [--seed S] [--lpn] [--replay entrada]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!fuzz_setup()) return 1;
+    printf("Semente %llu\n", (unsigned long long)rngState);
+    if (replay) return replay_input(replay);
+    return lpn ? fuzz_lpn(runs) : fuzz_images(runs);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdint.h>
+
+#include "neander.h"
+
+/* Disposição de uma imagem .mem, compartilhada pelo assembler e pelo ligador */
+typedef struct {
+    uint8_t header[HEADERSIZE];
+    int headerSize;
+    int bytesPerWord;
+    int words;
+    int dataStart;      /* -1: dados logo após o código */
+    int dataEnd;
+    int resultWord;
+} Layout;
+
+static const Layout STANDARD_LAYOUT = { HEADER_STANDARD, HEADERSIZE, 2, STANDARD_WORDS, STANDARD_DATA_START, STANDARD_WORDS, STANDARD_RESULT_WORD };
+static const Layout PACKED_LAYOUT   = { HEADER_PACKED,   HEADERSIZE, 1, PACKED_WORDS,   -1, PACKED_RESULT_WORD, PACKED_RESULT_WORD };
+
+/* words, dataEnd e resultWord são definidos por --words */
+static const Layout EXTENDED_LAYOUT = { HEADER_EXTENDED, EXTENDED_HEADERSIZE, 2, EXTENDED_DEFAULT_WORDS, -1,
+                                        EXTENDED_DEFAULT_WORDS - 1, EXTENDED_DEFAULT_WORDS - 1 };
+
+static inline void setExtendedWords(Layout* layout, int words) {
+    layout->words = words;
+    layout->dataEnd = words - 1;
+    layout->resultWord = words - 1;
+}
+
+static inline int wordOffset(const Layout* layout, int word) {
+    return layout->headerSize + word * layout->bytesPerWord;
+}
+
+/* Palavras de 16 bits só existem no formato estendido; nos demais value < 256 */
+static inline void storeWord(uint8_t* memory, const Layout* layout, int word, int value) {
+    memory[wordOffset(layout, word)] = (uint8_t)value;
+    if (layout->bytesPerWord == 2)
+        memory[wordOffset(layout, word) + 1] = (uint8_t)(value >> 8);
+}
+
+static inline void writeHeader(uint8_t* memory, const Layout* layout) {
+    for (int i = 0; i < HEADERSIZE; i++)
+        memory[i] = layout->header[i];
+    if (layout->headerSize == EXTENDED_HEADERSIZE) {
+        for (int i = 0; i < 4; i++)
+            memory[HEADERSIZE + i] = (uint8_t)(layout->words >> (8 * i));
+    }
+}
+
+static inline const char* layoutName(const Layout* layout) {
+    if (layout->bytesPerWord == 1) return "packed";
+    return layout->headerSize == EXTENDED_HEADERSIZE ? "extended" : "standard";
+}
+
+#endif
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "neander.h"
+#include "layout.h"
+
+typedef struct {
+    char name[32];
+    bool imported;
+    int word;
+} ObjectSymbol;
+
+typedef struct {
+    const char *path;
+    int codeWords;
+    int totalWords;
+    uint16_t *words;
+    int symbolCount;
+    ObjectSymbol *symbols;
+    int relocationCount;
+    uint16_t (*relocations)[2];
+    int codeBase;
+    int dataBase;
+} Object;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    bool ok;
+} Reader;
+
+int readByte(Reader *reader) {
+    if (reader->pos >= reader->size) {
+        reader->ok = false;
+        return 0;
+    }
+    return reader->data[reader->pos++];
+}
+
+int readU16(Reader *reader) {
+    int low = readByte(reader);
+    return low | (readByte(reader) << 8);
+}
+
+bool loadObject(const char *path, Object *object) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    size_t bytesRead = fread(data, 1, size, file);
+    fclose(file);
+
+    const uint8_t header[] = HEADER_OBJECT;
+    if (bytesRead < HEADERSIZE || memcmp(data, header, HEADERSIZE) != 0) {
+        fprintf(stderr, "%s: cabeçalho fora do padrão\n", path);
+        free(data);
+        return false;
+    }
+
+    Reader reader = { data, bytesRead, HEADERSIZE, true };
+    object->path = path;
+    object->codeWords = readU16(&reader);
+    object->totalWords = readU16(&reader);
+    object->words = malloc((object->totalWords + 1) * sizeof(uint16_t));
+    for (int i = 0; i < object->totalWords; i++)
+        object->words[i] = readU16(&reader);
+
+    object->symbolCount = readU16(&reader);
+    object->symbols = calloc(object->symbolCount + 1, sizeof(ObjectSymbol));
+    for (int i = 0; i < object->symbolCount && reader.ok; i++) {
+        ObjectSymbol *symbol = &object->symbols[i];
+        symbol->imported = readByte(&reader) == OBJECT_SYMBOL_IMPORT;
+        int length = readByte(&reader);
+        for (int j = 0; j < length; j++) {
+            int c = readByte(&reader);
+            if (j < (int)sizeof(symbol->name) - 1) symbol->name[j] = (char)c;
+        }
+        symbol->word = readU16(&reader);
+    }
+
+    object->relocationCount = readU16(&reader);
+    object->relocations = malloc((object->relocationCount + 1) * sizeof(*object->relocations));
+    for (int i = 0; i < object->relocationCount; i++) {
+        object->relocations[i][0] = readU16(&reader);
+        object->relocations[i][1] = readU16(&reader);
+    }
+    free(data);
+
+    if (!reader.ok || object->codeWords > object->totalWords) {
+        fprintf(stderr, "%s: objeto corrompido\n", path);
+        return false;
+    }
+    return true;
+}
+
+/* Endereço final de uma palavra interna do objeto: código e dados são movidos separadamente */
+int placeWord(const Object *object, int word) {
+    if (word < object->codeWords) return object->codeBase + word;
+    return object->dataBase + word - object->codeWords;
+}
+
+int findExport(Object *objects, int count, const char *name, const Layout *layout) {
+    if (strcmp(name, "RES") == 0) return layout->resultWord;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < objects[i].symbolCount; j++) {
+            ObjectSymbol *symbol = &objects[i].symbols[j];
+            if (!symbol->imported && strcmp(symbol->name, name) == 0)
+                return placeWord(&objects[i], symbol->word);
+        }
+    }
+    return -1;
+}
+
+bool checkDuplicates(Object *objects, int count) {
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < objects[i].symbolCount; j++) {
+            ObjectSymbol *symbol = &objects[i].symbols[j];
+            if (symbol->imported) continue;
+            for (int k = i + 1; k < count; k++) {
+                for (int l = 0; l < objects[k].symbolCount; l++) {
+                    if (!objects[k].symbols[l].imported && strcmp(objects[k].symbols[l].name, symbol->name) == 0) {
+                        fprintf(stderr, "Erro: %s exportado por %s e %s\n", symbol->name, objects[i].path, objects[k].path);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool linkObjects(Object *objects, int count, const Layout *layout, const char *outputFile) {
+    int codeWords = 0;
+    int dataWords = 0;
+    for (int i = 0; i < count; i++) {
+        objects[i].codeBase = codeWords;
+        codeWords += objects[i].codeWords;
+    }
+    int dataBase = layout->dataStart >= 0 ? layout->dataStart : codeWords;
+    for (int i = 0; i < count; i++) {
+        objects[i].dataBase = dataBase + dataWords;
+        dataWords += objects[i].totalWords - objects[i].codeWords;
+    }
+
+    int dataEnd = layout->dataEnd < layout->words ? layout->dataEnd : layout->words;
+    if ((layout->dataStart >= 0 && codeWords > layout->dataStart) || codeWords > layout->words) {
+        fprintf(stderr, "Erro: código excede a memória (%d palavras)\n", codeWords);
+        return false;
+    }
+    if (dataBase + dataWords > dataEnd) {
+        fprintf(stderr, "Erro: memória insuficiente para os dados (%d palavras)\n", dataWords);
+        return false;
+    }
+    if (!checkDuplicates(objects, count)) return false;
+
+    int imageSize = wordOffset(layout, layout->words);
+    uint8_t *memory = calloc(imageSize, 1);
+    writeHeader(memory, layout);
+
+    for (int i = 0; i < count; i++) {
+        Object *object = &objects[i];
+        for (int w = 0; w < object->totalWords; w++)
+            storeWord(memory, layout, placeWord(object, w), object->words[w]);
+
+        for (int r = 0; r < object->relocationCount; r++) {
+            int word = object->relocations[r][0];
+            int symbol = object->relocations[r][1];
+            if (word >= object->totalWords || (symbol != OBJECT_INTERNAL && symbol >= object->symbolCount)) {
+                fprintf(stderr, "%s: relocação inválida\n", object->path);
+                free(memory);
+                return false;
+            }
+            int value;
+            if (symbol == OBJECT_INTERNAL) {
+                value = placeWord(object, object->words[word]);
+            } else {
+                int target = findExport(objects, count, object->symbols[symbol].name, layout);
+                if (target < 0) {
+                    fprintf(stderr, "Símbolo indefinido: %s (em %s)\n", object->symbols[symbol].name, object->path);
+                    free(memory);
+                    return false;
+                }
+                value = target + object->words[word];
+            }
+            storeWord(memory, layout, placeWord(object, word), value);
+        }
+    }
+
+    FILE *out = fopen(outputFile, "wb");
+    if (!out) {
+        perror("Erro ao criar o arquivo de memória");
+        free(memory);
+        return false;
+    }
+    fwrite(memory, 1, imageSize, out);
+    fclose(out);
+    free(memory);
+    printf("%d objetos -> %s (%d palavras de código, %d de dados)\n", count, outputFile, codeWords, dataWords);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const Layout *layout = &STANDARD_LAYOUT;
+    Layout extended = EXTENDED_LAYOUT;
+    const char *outputFile = NULL;
+    const char **inputs = malloc(argc * sizeof(char *));
+    int inputCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--packed") == 0) {
+            layout = &PACKED_LAYOUT;
+        } else if (strcmp(argv[i], "--extended") == 0) {
+            layout = &extended;
+        } else if (strcmp(argv[i], "--words") == 0 && i + 1 < argc) {
+            int words = atoi(argv[++i]);
+            if (words < 4 || words > EXTENDED_MAX_WORDS) {
+                printf("Tamanho de memória inválido: %s (4 a %d palavras)\n", argv[i], EXTENDED_MAX_WORDS);
+                free(inputs);
+                return 1;
+            }
+            setExtendedWords(&extended, words);
+        } else if (!outputFile) {
+            outputFile = argv[i];
+        } else {
+            inputs[inputCount++] = argv[i];
+        }
+    }
+    if (!outputFile || inputCount == 0) {
+        printf("Uso: %s [--packed | --extended [--words N]] saida.mem programa.obj [biblioteca.obj...]\n", argv[0]);
+        free(inputs);
+        return 1;
+    }
+
+    Object *objects = calloc(inputCount, sizeof(Object));
+    bool ok = true;
+    for (int i = 0; i < inputCount && ok; i++)
+        ok = loadObject(inputs[i], &objects[i]);
+    if (ok)
+        ok = linkObjects(objects, inputCount, layout, outputFile);
+
+    for (int i = 0; i < inputCount; i++) {
+        free(objects[i].words);
+        free(objects[i].symbols);
+        free(objects[i].relocations);
+    }
+    free(objects);
+    free(inputs);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#ifndef NEANDER_H
+#define NEANDER_H
+
+#define HEADERSIZE 4
+
+#define HEADER_STANDARD {0x03, 0x4E, 0x44, 0x52}
+#define HEADER_PACKED   {0x03, 0x4E, 0x44, 0x50}
+#define HEADER_BUNDLE   {0x03, 0x4E, 0x44, 0x42}
+#define HEADER_EXTENDED {0x03, 0x4E, 0x44, 0x58}
+#define HEADER_OBJECT   {0x03, 0x4E, 0x44, 0x4F}
+#define HEADER_SNAPSHOT {0x03, 0x4E, 0x44, 0x53}
+#define HEADER_TRACE    {0x03, 0x4E, 0x44, 0x54}
+
+#define STANDARD_WORDS      254
+#define STANDARD_DATA_START 126
+#define PACKED_WORDS        256
+
+#define STANDARD_CODE_INSTRUCTIONS (STANDARD_DATA_START / 2)
+#define STANDARD_DATA_WORDS        (STANDARD_WORDS - STANDARD_DATA_START)
+
+#define STANDARD_IMAGESIZE (HEADERSIZE + STANDARD_WORDS * 2)
+#define PACKED_IMAGESIZE   (HEADERSIZE + PACKED_WORDS)
+
+/*
+ * Pacote (.nbd): cabeçalho HEADER_BUNDLE, u32 count, u32 offsets[count + 1]
+ * e as imagens. Cada imagem guarda o cabeçalho original, u16 runCount e
+ * runCount trechos {u16 offset, u16 length, bytes} relativos ao corpo da
+ * imagem (após o cabeçalho). Inteiros em little-endian.
+ */
+#define BUNDLE_RUN_GAP 4
+
+#define STANDARD_RESULT_WORD (STANDARD_DATA_START + 2)
+#define PACKED_RESULT_WORD   (PACKED_WORDS - 1)
+
+/*
+ * Imagem estendida: cabeçalho HEADER_EXTENDED, u32 words e words palavras
+ * de 16 bits em little-endian. PC e operandos são índices de palavra de 16
+ * bits; LDA/STA movem a palavra inteira e as operações aritméticas usam só
+ * o byte baixo, zerando o alto. RES fica na última palavra.
+ */
+#define EXTENDED_HEADERSIZE    (HEADERSIZE + 4)
+#define EXTENDED_DEFAULT_WORDS 4096
+#define EXTENDED_MAX_WORDS     65536
+
+/*
+ * Objeto relocável (.obj): cabeçalho HEADER_OBJECT, u16 codeWords,
+ * u16 totalWords e totalWords palavras u16 (código a partir da palavra 0,
+ * dados em seguida). Depois, u16 symbolCount e para cada símbolo
+ * {u8 tipo, u8 tamanho, nome, u16 palavra}, e u16 relocationCount com
+ * {u16 palavra, u16 símbolo}. Uma relocação interna guarda um endereço
+ * do próprio objeto; uma externa guarda o deslocamento somado ao símbolo
+ * importado. Inteiros em little-endian.
+ */
+#define OBJECT_SYMBOL_EXPORT 0
+#define OBJECT_SYMBOL_IMPORT 1
+#define OBJECT_INTERNAL      0xFFFF
+
+/*
+ * Snapshot (.snap): cabeçalho HEADER_SNAPSHOT, u8 formato (0 padrão,
+ * 1 compacto, 2 estendido), u8 flags (bit 0 Z, bit 1 N), u16 AC, u32 PC,
+ * u64 instruções executadas, u32 tamanho da memória e u32 runCount
+ * trechos {u32 offset, u32 length, bytes} da memória do executor.
+ */
+#define SNAPSHOT_FIXEDSIZE (HEADERSIZE + 24)
+
+/*
+ * Rastro (.ntr): cabeçalho HEADER_TRACE, u8 formato (como no snapshot),
+ * u8 reservado, u16 tamanho do registro, u32 count e u64 número da
+ * instrução do primeiro registro. Seguem count registros {u16 PC,
+ * u16 operando, u16 AC, u8 opcode, u8 reservado}, do mais antigo ao mais
+ * recente, com o estado antes de cada instrução.
+ */
+#define TRACE_FIXEDSIZE (HEADERSIZE + 16)
+#define TRACE_ENTRYSIZE 8
+
+#define OPCODE_NOP  0x00
+#define OPCODE_STA  0x10
+#define OPCODE_LDA  0x20
+#define OPCODE_ADD  0x30
+#define OPCODE_SUB  0x31
+#define OPCODE_OR   0x40
+#define OPCODE_AND  0x50
+#define OPCODE_NOT  0x60
+#define OPCODE_JMP  0x80
+#define OPCODE_JMN  0x90
+#define OPCODE_JMZ  0xA0
+#define OPCODE_HLT  0xF0
+
+/* Estados da unidade de controle por instrução (busca + execução) */
+#define CYCLES_NOP    4
+#define CYCLES_MEMORY 8     /* STA, LDA, ADD, SUB, OR, AND */
+#define CYCLES_NOT    4
+#define CYCLES_JUMP   6     /* JMP e desvio condicional tomado */
+#define CYCLES_JUMP_NOT_TAKEN 4
+#define CYCLES_HLT    4
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/*
+ * Medição opcional das etapas (--stats). Cada etapa gera uma linha em
+ * stderr no formato "stat <etapa> ns=<n> ...", lida pelo bench. Quando o
+ * kernel permite, a linha traz também os contadores de hardware da thread
+ * (perf_event_open); sem eles fica só o tempo de clock_gettime. Os
+ * contadores são herdados (inherit), então a etapa que cria e espera
+ * threads soma também o trabalho delas. allocs conta chamadas de
+ * malloc/calloc/realloc do processo inteiro e rss_kb é o pico de memória
+ * residente do processo até o fim da etapa.
+ */
+static bool statsEnabled = false;
+
+#define STAT_COUNTERS 4
+
+static const char *const STAT_COUNTER_NAMES[STAT_COUNTERS] = {
+    "cycles", "instructions", "branch_misses", "cache_misses"
+};
+
+static _Thread_local int statCounterFds[STAT_COUNTERS];
+static _Thread_local bool statCountersOpened = false;
+static unsigned long long statAllocations = 0;
+
+typedef struct {
+    const char *name;
+    uint64_t startNs;
+    uint64_t startCounters[STAT_COUNTERS];
+    unsigned long long startAllocations;
+} StatStage;
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+/* Contagem de alocações: cada ferramenta é um único .c, então substituir o malloc aqui é seguro */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+    if (statsEnabled) __atomic_fetch_add(&statAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (statsEnabled) __atomic_fetch_add(&statAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (statsEnabled) __atomic_fetch_add(&statAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+static inline uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Abre os contadores da thread atual na primeira etapa; os que falharem ficam em -1 */
+static inline void stats_open_counters(void) {
+    statCountersOpened = true;
+    bool any = false;
+    for (int i = 0; i < STAT_COUNTERS; i++) {
+        statCounterFds[i] = -1;
+#ifdef __linux__
+        static const uint64_t configs[STAT_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+        };
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        statCounterFds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (statCounterFds[i] >= 0) any = true;
+#endif
+    }
+    if (!any) {
+        static bool warned = false;
+        if (!__atomic_exchange_n(&warned, true, __ATOMIC_RELAXED))
+            fprintf(stderr, "stat counters=indisponiveis (usando clock_gettime)\n");
+    }
+}
+
+/* Fecha os contadores da thread atual; chamada pelas threads de trabalho ao terminar */
+static inline void stats_close_counters(void) {
+    if (!statCountersOpened) return;
+    for (int i = 0; i < STAT_COUNTERS; i++) {
+        if (statCounterFds[i] >= 0) close(statCounterFds[i]);
+        statCounterFds[i] = -1;
+    }
+    statCountersOpened = false;
+}
+
+static inline uint64_t stats_read_counter(int index) {
+    uint64_t value = 0;
+    if (statCounterFds[index] < 0 || read(statCounterFds[index], &value, sizeof(value)) != sizeof(value))
+        return 0;
+    return value;
+}
+
+static inline void stat_begin(StatStage *stage, const char *name) {
+    if (!statsEnabled) return;
+    if (!statCountersOpened) stats_open_counters();
+    stage->name = name;
+    stage->startAllocations = __atomic_load_n(&statAllocations, __ATOMIC_RELAXED);
+    for (int i = 0; i < STAT_COUNTERS; i++) stage->startCounters[i] = stats_read_counter(i);
+    stage->startNs = stats_now_ns();
+}
+
+/* Encerra a etapa uma única vez; chamadas seguintes não imprimem nada */
+static inline void stat_end(StatStage *stage) {
+    if (!statsEnabled || !stage->name) return;
+    uint64_t ns = stats_now_ns() - stage->startNs;
+    char line[512];
+    int len = snprintf(line, sizeof(line), "stat %s ns=%llu", stage->name, (unsigned long long)ns);
+    for (int i = 0; i < STAT_COUNTERS && len < (int)sizeof(line); i++) {
+        if (statCounterFds[i] < 0) continue;
+        len += snprintf(line + len, sizeof(line) - len, " %s=%llu", STAT_COUNTER_NAMES[i],
+                        (unsigned long long)(stats_read_counter(i) - stage->startCounters[i]));
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    if (len < (int)sizeof(line))
+        snprintf(line + len, sizeof(line) - len, " allocs=%llu rss_kb=%ld",
+                 __atomic_load_n(&statAllocations, __ATOMIC_RELAXED) - stage->startAllocations, usage.ru_maxrss);
+    fprintf(stderr, "%s\n", line);
+    stage->name = NULL;
+}
+
+#endif